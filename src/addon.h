@@ -0,0 +1,61 @@
+#ifndef COMMONJS_SERVER_ADDON_H
+#define COMMONJS_SERVER_ADDON_H
+
+#include "v8.h"
+#include "v8-fast-api-calls.h"
+
+/**
+ * 原生模块的嵌入 API。原生模块是导出注册函数的共享库，require('x.node') 时 dlopen 并调用注册函数，
+ * 注册函数通过 AddonExports 向模块的 exports 添加函数和值：
+ *
+ *    void add(const v8::FunctionCallbackInfo<v8::Value>& info);   // 慢路径，解释执行和未优化代码调用
+ *    int32_t fastAdd(v8::ApiObject receiver, int32_t a, int32_t b); // 快路径，优化代码直接调用
+ *    const v8::CFunction kFastAdd = v8::CFunction::Make(fastAdd);
+ *
+ *    void registerAddon(AddonExports& exports) {
+ *        exports.setFunction("add", add, &kFastAdd, 2);
+ *    }
+ *    COMMONJS_ADDON(registerAddon)
+ *
+ * 快路径的第一个参数是接收者，其余参数和返回值只能是标量。快路径不能分配 JS 对象、不能执行 JS、不能抛出异常，
+ * 需要这些操作时用 v8::FastApiCallbackOptions 参数回退到慢路径。
+ * 共享库中的 v8 符号由宿主进程提供，原生模块必须用相同版本的 v8 头文件编译。
+ */
+class AddonExports {
+public:
+    virtual ~AddonExports() = default;
+
+    virtual v8::Isolate* isolate() const = 0;
+
+    virtual v8::Local<v8::Context> context() const = 0;
+
+    /**
+     * 导出函数
+     * @param name 属性名
+     * @param callback 慢路径
+     * @param fastCallback 快路径，没有时为 nullptr。必须在进程生命周期内有效
+     * @param length 函数的 length
+     */
+    virtual void setFunction(const char* name, v8::FunctionCallback callback,
+                             const v8::CFunction* fastCallback = nullptr, int length = 0) = 0;
+
+    /**
+     * 导出值
+     * @param name 属性名
+     * @param value
+     */
+    virtual void setValue(const char* name, v8::Local<v8::Value> value) = 0;
+};
+
+// 原生模块注册函数的符号名
+#define COMMONJS_ADDON_SYMBOL "commonjs_addon_register"
+
+typedef void (*AddonRegisterFunction)(AddonExports& exports);
+
+// 在原生模块中导出注册函数
+#define COMMONJS_ADDON(function)                                                                   \
+    extern "C" __attribute__((visibility("default"))) void commonjs_addon_register(AddonExports& exports) { \
+        function(exports);                                                                         \
+    }
+
+#endif //COMMONJS_SERVER_ADDON_H
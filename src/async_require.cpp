@@ -0,0 +1,160 @@
+#include "async_require.h"
+#include <algorithm>
+#include <memory>
+
+/**
+ * 一次 require.async 请求，从发起到微任务执行期间由事件循环的完成队列持有
+ */
+struct AsyncRequires::Request {
+    AsyncRequires* owner;
+    v8::Isolate* isolate;
+    // 请求的模块，按参数顺序排列
+    std::vector<uint32_t> pathIds;
+    // 去重之后的模块
+    std::vector<uint32_t> unique;
+    // 还没有在后台就绪或者还没有准备完成的模块数，只在主线程修改
+    size_t remaining;
+    // 是否已经开始准备
+    bool preparing;
+    uint32_t parentPathId;
+    bool batch;
+    v8::Global<v8::Context> context;
+    v8::Global<v8::Function> callback;
+    v8::Global<v8::Promise::Resolver> resolver;
+};
+
+v8::Local<v8::Value> AsyncRequires::require(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t pathId,
+                                            uint32_t parentPathId, v8::Local<v8::Function> callback) {
+    return start(isolate, context, std::vector<uint32_t>(1, pathId), parentPathId, callback, false);
+}
+
+v8::Local<v8::Value> AsyncRequires::requireAll(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::vector<uint32_t>& pathIds,
+                                               uint32_t parentPathId, v8::Local<v8::Function> callback) {
+    return start(isolate, context, pathIds, parentPathId, callback, true);
+}
+
+v8::Local<v8::Value> AsyncRequires::start(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::vector<uint32_t>& pathIds,
+                                          uint32_t parentPathId, v8::Local<v8::Function> callback, bool batch) {
+    v8::EscapableHandleScope handleScope(isolate);
+    Request* request = new Request();
+    request->owner = this;
+    request->isolate = isolate;
+    request->pathIds = pathIds;
+    request->parentPathId = parentPathId;
+    request->batch = batch;
+    request->preparing = false;
+    request->context.Reset(isolate, context);
+    v8::Local<v8::Value> result = v8::Undefined(isolate);
+    if (callback.IsEmpty()) {
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+        request->resolver.Reset(isolate, resolver);
+        result = resolver->GetPromise();
+    } else {
+        request->callback.Reset(isolate, callback);
+    }
+    // 同一请求中重复的模块只读取一次
+    std::vector<uint32_t>& unique = request->unique;
+    unique = pathIds;
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    pending_++;
+    loop_.ref();
+    request->remaining = std::max<size_t>(unique.size(), 1);
+    if (unique.empty()) {
+        // 空数组同样在下一轮回调
+        loop_.post(ready, request);
+    }
+    // 所有模块同时交给线程池。已经加载或者已经预取完成的模块会立即投递，回调仍然在下一个宏任务处理，始终是异步的
+    for (uint32_t pathId : unique) {
+        prefetcher_.load(isolate, pathId, [this, request]() {
+            loop_.post(ready, request);
+        });
+    }
+    return handleScope.Escape(result);
+}
+
+void AsyncRequires::ready(void* data) {
+    // 每个模块就绪时投递一次，全部就绪之后才执行
+    Request* request = static_cast<Request*>(data);
+    if (--request->remaining > 0) {
+        return;
+    }
+    if (!request->preparing && request->owner->preparer_ != nullptr) {
+        // 全部读取完成之后开始准备，准备中的模块各自完成时再次调用，多计的一次在最后扣除
+        request->preparing = true;
+        request->remaining = 1;
+        v8::Isolate* isolate = request->isolate;
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> context = request->context.Get(isolate);
+        v8::Context::Scope contextScope(context);
+        for (uint32_t pathId : request->unique) {
+            if (request->owner->preparer_(isolate, context, pathId, ready, request)) {
+                request->remaining++;
+            }
+        }
+        if (--request->remaining > 0) {
+            return;
+        }
+    }
+    request->isolate->EnqueueMicrotask(finish, request);
+}
+
+v8::MaybeLocal<v8::Value> AsyncRequires::load(Request* request, v8::Local<v8::Context> context, uint32_t pathId, v8::Local<v8::Value>& error) {
+    v8::Isolate* isolate = request->isolate;
+    v8::TryCatch tryCatch(isolate);
+    // 源码已经在后台读取(和编译)，这里命中预取结果，只剩执行
+    v8::Local<v8::Value> exports;
+    if (loader_(isolate, context, pathId, request->parentPathId).ToLocal(&exports)) {
+        return exports;
+    }
+    if (tryCatch.HasCaught()) {
+        error = tryCatch.Exception();
+    } else {
+        std::string message = "模块加载失败: " + paths_.path(pathId);
+        error = v8::Exception::Error(v8::String::NewFromUtf8(isolate, message.data(), v8::NewStringType::kNormal,
+                                                             static_cast<int>(message.size())).ToLocalChecked());
+    }
+    return v8::MaybeLocal<v8::Value>();
+}
+
+void AsyncRequires::finish(void* data) {
+    std::unique_ptr<Request> request(static_cast<Request*>(data));
+    AsyncRequires* self = request->owner;
+    v8::Isolate* isolate = request->isolate;
+    v8::HandleScope handleScope(isolate);
+    v8::Local<v8::Context> context = request->context.Get(isolate);
+    v8::Context::Scope contextScope(context);
+    self->pending_--;
+    self->loop_.unref();
+
+    // 按参数顺序执行，加载失败的模块为 null，记录第一个错误
+    std::vector<v8::Local<v8::Value>> results;
+    v8::Local<v8::Value> error;
+    for (uint32_t pathId : request->pathIds) {
+        v8::Local<v8::Value> moduleError;
+        v8::Local<v8::Value> exports;
+        if (!self->load(request.get(), context, pathId, moduleError).ToLocal(&exports)) {
+            exports = v8::Null(isolate);
+            if (error.IsEmpty()) {
+                error = moduleError;
+            }
+        }
+        results.push_back(exports);
+    }
+    if (!request->callback.IsEmpty()) {
+        // 单个模块失败时与原来的约定一致，第一个参数为 null，第二个参数为错误
+        if (!request->batch && !error.IsEmpty()) {
+            results.push_back(error);
+        }
+        if (request->callback.Get(isolate)->Call(context, context->Global(), static_cast<int>(results.size()), results.data()).IsEmpty()) {
+            // 回调抛出的异常交给微任务队列处理
+            return;
+        }
+    } else if (!error.IsEmpty()) {
+        request->resolver.Get(isolate)->Reject(context, error).FromJust();
+    } else if (request->batch) {
+        request->resolver.Get(isolate)->Resolve(context, v8::Array::New(isolate, results.data(), results.size())).FromJust();
+    } else {
+        request->resolver.Get(isolate)->Resolve(context, results[0]).FromJust();
+    }
+}
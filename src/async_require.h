@@ -0,0 +1,110 @@
+#ifndef COMMONJS_SERVER_ASYNC_REQUIRE_H
+#define COMMONJS_SERVER_ASYNC_REQUIRE_H
+
+#include <cstdint>
+#include <vector>
+#include "v8.h"
+#include "event_loop.h"
+#include "module_prefetcher.h"
+#include "path_resolver.h"
+
+/**
+ * require.async 的实现。模块源码在预取器的线程池中读取，define 模块同时在后台流式编译，
+ * 完成之后作为宏任务投递到事件循环；请求的模块全部就绪时以原生微任务在 isolate 线程上执行模块，
+ * 再调用回调或者完成 Promise。每个进行中的请求引用一次事件循环，全部完成之前循环不会退出。
+ * 一次请求可以包含一组模块，所有模块都在后台并行读取，全部就绪之后按顺序执行，只调用一次回调；
+ * 同一个模块正在被其他请求加载时共用同一次后台读取。
+ * 模块全部读取完成之后，还可以在 isolate 线程上异步准备(wasm 模块在事件循环中流式编译)，准备完成之后再执行。
+ */
+class AsyncRequires {
+public:
+    /**
+     * 加载模块的函数，返回模块的 exports，加载失败时返回空
+     */
+    typedef v8::MaybeLocal<v8::Value> (*Loader)(v8::Isolate* isolate, v8::Local<v8::Context> context,
+                                                uint32_t pathId, uint32_t parentPathId);
+
+    /**
+     * 在 isolate 线程上异步准备已经读取完成的模块
+     * @return 开始了异步准备时返回 true，完成之后在 isolate 线程上调用 done(data)；不需要准备时返回 false
+     */
+    typedef bool (*Preparer)(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t pathId,
+                             CompletionQueue::Callback done, void* data);
+
+    AsyncRequires(const PathTable& paths, ModulePrefetcher& prefetcher, EventLoop& loop, Loader loader, Preparer preparer)
+            : paths_(paths), prefetcher_(prefetcher), loop_(loop), loader_(loader), preparer_(preparer) {}
+
+    /**
+     * 发起异步加载，立即返回
+     * @param isolate
+     * @param context
+     * @param pathId 模块绝对路径 id
+     * @param parentPathId 父模块绝对路径 id
+     * @param callback 完成时的回调 callback(exports)，失败时为 callback(null, error)。为空时返回 Promise
+     * @return callback 为空时返回 Promise，否则返回 undefined
+     */
+    v8::Local<v8::Value> require(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t pathId,
+                                 uint32_t parentPathId, v8::Local<v8::Function> callback);
+
+    /**
+     * 发起一组模块的异步加载，立即返回
+     * @param isolate
+     * @param context
+     * @param pathIds 模块绝对路径 id，可以重复
+     * @param parentPathId 父模块绝对路径 id
+     * @param callback 全部完成时的回调 callback(exports1, exports2, ...)，加载失败的模块为 null。为空时返回 Promise
+     * @return callback 为空时返回 Promise，结果为 exports 数组，任意模块失败时 reject；否则返回 undefined
+     */
+    v8::Local<v8::Value> requireAll(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::vector<uint32_t>& pathIds,
+                                    uint32_t parentPathId, v8::Local<v8::Function> callback);
+
+    // 还没有完成的请求数
+    size_t pending() const { return pending_; }
+
+private:
+    struct Request;
+
+    /**
+     * 创建请求并在后台开始读取其中的模块
+     * @param isolate
+     * @param context
+     * @param pathIds
+     * @param parentPathId
+     * @param callback
+     * @param batch 是否为数组形式的请求
+     * @return
+     */
+    v8::Local<v8::Value> start(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::vector<uint32_t>& pathIds,
+                               uint32_t parentPathId, v8::Local<v8::Function> callback, bool batch);
+
+    /**
+     * 在 isolate 线程上加载模块
+     * @param request
+     * @param context
+     * @param pathId
+     * @param error 输出加载失败的原因
+     * @return
+     */
+    v8::MaybeLocal<v8::Value> load(Request* request, v8::Local<v8::Context> context, uint32_t pathId, v8::Local<v8::Value>& error);
+
+    /**
+     * 模块在后台就绪或者准备完成时调用，请求的模块全部读取完成之后开始准备，全部准备完成之后放入完成请求的微任务
+     * @param data Request
+     */
+    static void ready(void* data);
+
+    /**
+     * 完成请求的微任务
+     * @param data Request
+     */
+    static void finish(void* data);
+
+    const PathTable& paths_;
+    ModulePrefetcher& prefetcher_;
+    EventLoop& loop_;
+    Loader loader_;
+    Preparer preparer_;
+    size_t pending_ = 0;
+};
+
+#endif //COMMONJS_SERVER_ASYNC_REQUIRE_H
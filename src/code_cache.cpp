@@ -0,0 +1,174 @@
+#include "code_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// 缓存文件魔数 "CJSC"
+const uint32_t kCacheMagic = 0x43534a43;
+
+/**
+ * 缓存文件头，后面依次跟着 模块绝对路径 和 代码缓存数据
+ */
+struct CacheHeader {
+    uint32_t magic;
+    // ScriptCompiler::CachedDataVersionTag，v8 版本或 flag 变化时失效
+    uint32_t versionTag;
+    int64_t mtime;
+    uint64_t hash;
+    uint32_t pathLength;
+    uint32_t dataLength;
+};
+
+}
+
+uint64_t contentHash(const char* data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t index = 0; index < length; ++index) {
+        hash ^= static_cast<uint8_t>(data[index]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string CodeCache::cacheFilePath(const std::string& path) {
+    size_t index = path.find_last_of('/');
+    if (index == std::string::npos) {
+        return ".v8cache/" + path + ".cache";
+    }
+    return path.substr(0, index) + "/.v8cache/" + path.substr(index + 1) + ".cache";
+}
+
+v8::ScriptCompiler::CachedData* CodeCache::load(const std::string& path, const SourceStamp& stamp) {
+    Lookup lookup;
+    v8::ScriptCompiler::CachedData* data = read(path, stamp, lookup);
+    record(lookup);
+    return data;
+}
+
+v8::ScriptCompiler::CachedData* CodeCache::read(const std::string& path, const SourceStamp& stamp, Lookup& lookup) const {
+    lookup = Lookup::kMiss;
+    if (!enabled_) {
+        return nullptr;
+    }
+    FILE* file = fopen(cacheFilePath(path).c_str(), "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    CacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 header.magic == kCacheMagic &&
+                 header.mtime == stamp.mtime &&
+                 header.hash == stamp.hash &&
+                 header.pathLength == path.size();
+    if (valid) {
+        std::string cachedPath(header.pathLength, '\0');
+        valid = fread(&cachedPath[0], 1, header.pathLength, file) == header.pathLength && cachedPath == path;
+    }
+    if (!valid) {
+        // 缓存文件属于旧版本的源码
+        fclose(file);
+        return nullptr;
+    }
+    if (header.versionTag != v8::ScriptCompiler::CachedDataVersionTag()) {
+        // v8 版本或者 flag 已经变化，v8 必定会拒绝这份缓存，不需要再读取数据
+        fclose(file);
+        lookup = Lookup::kRejected;
+        return nullptr;
+    }
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[header.dataLength]);
+    size_t length = fread(buffer.get(), 1, header.dataLength, file);
+    fclose(file);
+    if (length != header.dataLength) {
+        return nullptr;
+    }
+    lookup = Lookup::kFound;
+    return new v8::ScriptCompiler::CachedData(buffer.release(), static_cast<int>(header.dataLength),
+                                              v8::ScriptCompiler::CachedData::BufferOwned);
+}
+
+void CodeCache::record(Lookup lookup) {
+    if (!enabled_) {
+        return;
+    }
+    if (lookup == Lookup::kMiss) {
+        stats_.misses++;
+    } else if (lookup == Lookup::kRejected) {
+        stats_.rejected++;
+    }
+}
+
+bool CodeCache::exists(const std::string& path) const {
+    return enabled_ && access(cacheFilePath(path).c_str(), R_OK) == 0;
+}
+
+bool CodeCache::report(const v8::ScriptCompiler::CachedData* data) {
+    if (data == nullptr) {
+        return false;
+    }
+    if (data->rejected) {
+        stats_.rejected++;
+        return false;
+    }
+    stats_.hits++;
+    return true;
+}
+
+void CodeCache::save(const std::string& path, const SourceStamp& stamp, const v8::ScriptCompiler::CachedData* data) {
+    if (!enabled_ || data == nullptr || data->length <= 0) {
+        return;
+    }
+    std::string cachePath = cacheFilePath(path);
+    std::string cacheDir = cachePath.substr(0, cachePath.find_last_of('/'));
+    // 缓存目录不存在时创建，已存在时 mkdir 失败可以忽略
+    mkdir(cacheDir.c_str(), 0755);
+
+    std::string tempPath = cachePath + "." + std::to_string(getpid()) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    CacheHeader header;
+    header.magic = kCacheMagic;
+    header.versionTag = v8::ScriptCompiler::CachedDataVersionTag();
+    header.mtime = stamp.mtime;
+    header.hash = stamp.hash;
+    header.pathLength = static_cast<uint32_t>(path.size());
+    header.dataLength = static_cast<uint32_t>(data->length);
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(path.data(), 1, path.size(), file) == path.size() &&
+                   fwrite(data->data, 1, data->length, file) == static_cast<size_t>(data->length);
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return;
+    }
+    stats_.writes++;
+}
+
+void CodeCache::save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::UnboundScript> script) {
+    if (!enabled_) {
+        return;
+    }
+    std::unique_ptr<v8::ScriptCompiler::CachedData> data(v8::ScriptCompiler::CreateCodeCache(script));
+    save(path, stamp, data.get());
+}
+
+void CodeCache::save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::Function> function) {
+    if (!enabled_) {
+        return;
+    }
+    std::unique_ptr<v8::ScriptCompiler::CachedData> data(v8::ScriptCompiler::CreateCodeCacheForFunction(function));
+    save(path, stamp, data.get());
+}
+
+void CodeCache::save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::UnboundModuleScript> script) {
+    if (!enabled_) {
+        return;
+    }
+    std::unique_ptr<v8::ScriptCompiler::CachedData> data(v8::ScriptCompiler::CreateCodeCache(script));
+    save(path, stamp, data.get());
+}
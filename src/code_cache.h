@@ -0,0 +1,145 @@
+#ifndef COMMONJS_SERVER_CODE_CACHE_H
+#define COMMONJS_SERVER_CODE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include "v8.h"
+
+/**
+ * 模块源码的版本戳。代码缓存以 模块绝对路径 + mtime + 内容hash 作为key，
+ * 任意一项变化都会导致缓存失效。
+ */
+struct SourceStamp {
+    // 文件最后修改时间(纳秒)
+    int64_t mtime = 0;
+    // 源码内容的 FNV-1a 64 hash
+    uint64_t hash = 0;
+};
+
+/**
+ * 计算一段内存的 FNV-1a 64 位 hash
+ * @param data
+ * @param length
+ * @return
+ */
+uint64_t contentHash(const char* data, size_t length);
+
+/**
+ * 持久化的 v8 代码缓存。
+ * 缓存文件保存在模块所在目录的 .v8cache 目录下，文件名为 模块文件名 + ".cache"。
+ * 首次执行模块后通过 ScriptCompiler::CreateCodeCache 生成缓存，这样模块执行期间
+ * 惰性编译的函数也会被包含进去。下次启动时以 kConsumeCodeCache 编译。
+ */
+class CodeCache {
+public:
+    struct Stats {
+        // v8 接受了缓存
+        uint64_t hits = 0;
+        // 没有缓存文件或者缓存已过期
+        uint64_t misses = 0;
+        // 缓存文件有效，但是 v8 拒绝了缓存数据(版本或者flag不一致)
+        uint64_t rejected = 0;
+        // 写入的缓存文件数量
+        uint64_t writes = 0;
+    };
+
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+
+    /**
+     * 缓存文件的查找结果
+     */
+    enum class Lookup {
+        // 找到有效的缓存文件
+        kFound,
+        // 没有缓存文件或者缓存已过期
+        kMiss,
+        // 缓存由其他 v8 版本或 flag 生成
+        kRejected
+    };
+
+    /**
+     * 查找模块的代码缓存，未命中时记录一次 miss 并返回 nullptr。
+     * 返回的 CachedData 拥有自己的缓冲区，交由 ScriptCompiler::Source 释放。
+     * @param path 模块绝对路径
+     * @param stamp 模块源码版本戳
+     * @return
+     */
+    v8::ScriptCompiler::CachedData* load(const std::string& path, const SourceStamp& stamp);
+
+    /**
+     * 读取缓存文件，不更新统计，可以在后台线程调用
+     * @param path 模块绝对路径
+     * @param stamp 模块源码版本戳
+     * @param lookup 输出查找结果
+     * @return
+     */
+    v8::ScriptCompiler::CachedData* read(const std::string& path, const SourceStamp& stamp, Lookup& lookup) const;
+
+    /**
+     * 记录后台线程读取缓存的结果，命中的情况由 report 记录
+     * @param lookup
+     */
+    void record(Lookup lookup);
+
+    /**
+     * 模块是否存在缓存文件(不检查是否过期)
+     * @param path 模块绝对路径
+     * @return
+     */
+    bool exists(const std::string& path) const;
+
+    /**
+     * 记录 v8 对缓存数据的处理结果
+     * @param data 编译时传入的缓存数据
+     * @return v8 是否接受了缓存
+     */
+    bool report(const v8::ScriptCompiler::CachedData* data);
+
+    /**
+     * 把代码缓存写入缓存文件。先写临时文件再 rename，避免其他进程读到写了一半的缓存。
+     * @param path 模块绝对路径
+     * @param stamp 模块源码版本戳
+     * @param data 代码缓存数据，调用方负责释放
+     */
+    void save(const std::string& path, const SourceStamp& stamp, const v8::ScriptCompiler::CachedData* data);
+
+    /**
+     * 为脚本生成代码缓存并写入缓存文件
+     * @param path
+     * @param stamp
+     * @param script
+     */
+    void save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::UnboundScript> script);
+
+    /**
+     * 为 CompileFunctionInContext 编译的模块函数生成代码缓存并写入缓存文件
+     * @param path
+     * @param stamp
+     * @param function
+     */
+    void save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::Function> function);
+
+    /**
+     * 为 ES 模块生成代码缓存并写入缓存文件
+     * @param path
+     * @param stamp
+     * @param script
+     */
+    void save(const std::string& path, const SourceStamp& stamp, v8::Local<v8::UnboundModuleScript> script);
+
+    const Stats& stats() const { return stats_; }
+
+    /**
+     * 模块对应的缓存文件路径
+     * @param path 模块绝对路径
+     * @return
+     */
+    static std::string cacheFilePath(const std::string& path);
+
+private:
+    bool enabled_ = true;
+    Stats stats_;
+};
+
+#endif //COMMONJS_SERVER_CODE_CACHE_H
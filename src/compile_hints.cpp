@@ -0,0 +1,89 @@
+#include "compile_hints.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+// 采样间隔(微秒)。预热运行只跑一次，用比默认更密的采样换取更完整的覆盖
+const int kSamplingIntervalMicros = 50;
+
+}
+
+bool CompileHints::load(const std::string& file, PathTable& paths) {
+    std::ifstream in(file.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        // 只接受绝对路径，忽略空行
+        if (tab != std::string::npos && tab + 1 < line.size() && line[tab + 1] == '/') {
+            markHot(paths.intern(line.substr(tab + 1)));
+        }
+    }
+    return true;
+}
+
+void CompileHints::markHot(uint32_t pathId) {
+    if (pathId >= hot_.size()) {
+        hot_.resize(pathId + 1, false);
+    }
+    hot_[pathId] = true;
+}
+
+void CompileHints::startRecording(v8::Isolate* isolate) {
+    if (profiler_ != nullptr) {
+        return;
+    }
+    profiler_ = v8::CpuProfiler::New(isolate);
+    profiler_->SetSamplingInterval(kSamplingIntervalMicros);
+    profiler_->StartProfiling(v8::String::NewFromUtf8Literal(isolate, "compile-hints"), v8::kLeafNodeLineNumbers);
+}
+
+void CompileHints::stopRecording(v8::Isolate* isolate, const PathTable& paths) {
+    if (profiler_ == nullptr) {
+        return;
+    }
+    v8::HandleScope handleScope(isolate);
+    v8::CpuProfile* profile = profiler_->StopProfiling(v8::String::NewFromUtf8Literal(isolate, "compile-hints"));
+    if (profile != nullptr) {
+        collect(profile->GetTopDownRoot(), paths);
+        profile->Delete();
+    }
+    profiler_->Dispose();
+    profiler_ = nullptr;
+    for (const auto& hit : hits_) {
+        markHot(hit.first);
+    }
+}
+
+void CompileHints::collect(const v8::CpuProfileNode* node, const PathTable& paths) {
+    // 模块的顶层代码总是立即编译的，只统计其中的函数
+    bool topLevel = *node->GetFunctionNameStr() == '\0' && node->GetLineNumber() <= 1 && node->GetColumnNumber() <= 1;
+    if (node->GetHitCount() > 0 && !topLevel && *node->GetScriptResourceNameStr() != '\0') {
+        uint32_t pathId = paths.find(node->GetScriptResourceNameStr());
+        if (pathId != kInvalidPathId) {
+            hits_[pathId] += node->GetHitCount();
+        }
+    }
+    for (int index = 0; index < node->GetChildrenCount(); ++index) {
+        collect(node->GetChild(index), paths);
+    }
+}
+
+bool CompileHints::save(const std::string& file, const PathTable& paths) const {
+    std::vector<std::pair<uint64_t, uint32_t>> modules;
+    for (const auto& hit : hits_) {
+        modules.emplace_back(hit.second, hit.first);
+    }
+    std::sort(modules.begin(), modules.end(), [](const std::pair<uint64_t, uint32_t>& left, const std::pair<uint64_t, uint32_t>& right) {
+        return left.first > right.first;
+    });
+    std::ofstream out(file.c_str(), std::ios::trunc);
+    for (const auto& module : modules) {
+        out << module.first << '\t' << paths.path(module.second) << '\n';
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
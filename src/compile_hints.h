@@ -0,0 +1,76 @@
+#ifndef COMMONJS_SERVER_COMPILE_HINTS_H
+#define COMMONJS_SERVER_COMPILE_HINTS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "v8.h"
+#include "v8-profiler.h"
+#include "path_resolver.h"
+
+/**
+ * 预热编译提示。预热运行时用 CpuProfiler 采样，记录哪些模块里的函数真正执行过(热模块)，
+ * 之后的启动对热模块以 ScriptCompiler::kEagerCompile 编译，避免第一次请求时再惰性编译这些函数。
+ * 文件格式为每行一个模块： 采样次数 \t 绝对路径，按采样次数降序排列。
+ */
+class CompileHints {
+public:
+    /**
+     * 读取提示文件
+     * @param file
+     * @param paths
+     * @return 是否成功
+     */
+    bool load(const std::string& file, PathTable& paths);
+
+    /**
+     * 模块是否需要立即编译
+     * @param pathId 模块绝对路径 id
+     * @return
+     */
+    bool isHot(uint32_t pathId) const {
+        return pathId < hot_.size() && hot_[pathId];
+    }
+
+    /**
+     * 开始采样
+     * @param isolate
+     */
+    void startRecording(v8::Isolate* isolate);
+
+    bool recording() const { return profiler_ != nullptr; }
+
+    /**
+     * 停止采样，按模块统计采样次数，采样到的模块都标记为热模块
+     * @param isolate
+     * @param paths
+     */
+    void stopRecording(v8::Isolate* isolate, const PathTable& paths);
+
+    /**
+     * 写入提示文件
+     * @param file
+     * @param paths
+     * @return 是否成功
+     */
+    bool save(const std::string& file, const PathTable& paths) const;
+
+private:
+    /**
+     * 累加调用树中属于模块的采样次数，模块的顶层代码不计入
+     * @param node
+     * @param paths
+     */
+    void collect(const v8::CpuProfileNode* node, const PathTable& paths);
+
+    void markHot(uint32_t pathId);
+
+    v8::CpuProfiler* profiler_ = nullptr;
+    // 以路径 id 为下标的热模块
+    std::vector<bool> hot_;
+    // 路径 id -> 采样次数
+    std::unordered_map<uint32_t, uint64_t> hits_;
+};
+
+#endif //COMMONJS_SERVER_COMPILE_HINTS_H
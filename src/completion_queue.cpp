@@ -0,0 +1,62 @@
+#include "completion_queue.h"
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+CompletionQueue::~CompletionQueue() {
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    while (node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool CompletionQueue::open() {
+    if (fd_ < 0) {
+        fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    return fd_ >= 0;
+}
+
+void CompletionQueue::push(Callback callback, void* data) {
+    Node* node = new Node{ { callback, data }, nullptr };
+    Node* head = head_.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    // 队列原本不为空时消费者一定还没有取走链表，已经有一次唤醒
+    if (head == nullptr) {
+        signal();
+    }
+}
+
+void CompletionQueue::signal() {
+    uint64_t one = 1;
+    ssize_t written = write(fd_, &one, sizeof(one));
+    (void) written;
+}
+
+void CompletionQueue::take(std::vector<Completion>& completions) {
+    // 先清空计数再取链表，之后放入的任务会重新唤醒
+    uint64_t count;
+    ssize_t length = read(fd_, &count, sizeof(count));
+    (void) length;
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    Node* ordered = nullptr;
+    while (node != nullptr) {
+        Node* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    while (ordered != nullptr) {
+        Node* next = ordered->next;
+        completions.push_back(ordered->completion);
+        delete ordered;
+        ordered = next;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef COMMONJS_SERVER_COMPLETION_QUEUE_H
+#define COMMONJS_SERVER_COMPLETION_QUEUE_H
+
+#include <atomic>
+#include <vector>
+
+/**
+ * 后台任务的完成队列，多个生产者、单个消费者，无锁。
+ * 后台线程用 CAS 把完成的任务压入链表头，队列由空变为非空时写 eventfd 唤醒事件循环；
+ * 主线程在 eventfd 可读时一次取走整个链表，反转之后按完成顺序在 isolate 线程上继续处理
+ */
+class CompletionQueue {
+public:
+    /**
+     * 在 isolate 线程上继续处理完成的任务
+     */
+    typedef void (*Callback)(void* data);
+
+    struct Completion {
+        Callback callback;
+        void* data;
+    };
+
+    CompletionQueue() = default;
+    ~CompletionQueue();
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    /**
+     * 创建唤醒用的 eventfd
+     * @return 是否成功
+     */
+    bool open();
+
+    // eventfd，可读时表示队列中有完成的任务
+    int fd() const { return fd_; }
+
+    /**
+     * 放入完成的任务，可以在任意线程调用
+     * @param callback
+     * @param data
+     */
+    void push(Callback callback, void* data);
+
+    /**
+     * 只唤醒消费者，不放入任务，可以在任意线程调用
+     */
+    void signal();
+
+    /**
+     * 取出队列中的所有任务，不阻塞
+     * @param completions 输出完成的任务，按完成顺序排列
+     */
+    void take(std::vector<Completion>& completions);
+
+private:
+    struct Node {
+        Completion completion;
+        Node* next;
+    };
+
+    int fd_ = -1;
+    // 最后放入的任务，链表按放入顺序的逆序排列
+    std::atomic<Node*> head_{nullptr};
+};
+
+#endif //COMMONJS_SERVER_COMPLETION_QUEUE_H
@@ -0,0 +1,256 @@
+#include "dependency_graph.h"
+#include <algorithm>
+
+namespace {
+
+const std::vector<uint32_t> kNoDependencies;
+
+/**
+ * 输出 JSON / dot 字符串字面量，转义引号、反斜杠和控制字符
+ * @param out
+ * @param value
+ */
+void writeQuoted(std::ostream& out, const std::string& value) {
+    static const char kHex[] = "0123456789abcdef";
+    out << '"';
+    for (char ch : value) {
+        if (ch == '"' || ch == '\\') {
+            out << '\\' << ch;
+        } else if (static_cast<unsigned char>(ch) < 0x20) {
+            out << "\\u00" << kHex[(ch >> 4) & 0xf] << kHex[ch & 0xf];
+        } else {
+            out << ch;
+        }
+    }
+    out << '"';
+}
+
+v8::Local<v8::String> newString(v8::Isolate* isolate, const std::string& value) {
+    return v8::String::NewFromUtf8(isolate, value.data(), v8::NewStringType::kNormal,
+                                   static_cast<int>(value.size())).ToLocalChecked();
+}
+
+}
+
+void DependencyGraph::attach(v8::Isolate* isolate) {
+    isolate->SetData(kDependencyGraphSlot, this);
+}
+
+DependencyGraph* DependencyGraph::from(v8::Isolate* isolate) {
+    return static_cast<DependencyGraph*>(isolate->GetData(kDependencyGraphSlot));
+}
+
+bool DependencyGraph::addEdge(uint32_t from, uint32_t to) {
+    if (!edges_.insert(edgeKey(from, to)).second) {
+        return false;
+    }
+    if (from >= dependencies_.size()) {
+        dependencies_.resize(from + 1);
+    }
+    dependencies_[from].push_back(to);
+    if (to >= dependents_.size()) {
+        dependents_.resize(to + 1);
+    }
+    dependents_[to].push_back(from);
+    return true;
+}
+
+const std::vector<uint32_t>& DependencyGraph::dependents(uint32_t moduleId) const {
+    return moduleId < dependents_.size() ? dependents_[moduleId] : kNoDependencies;
+}
+
+void DependencyGraph::removeDependencies(uint32_t moduleId) {
+    if (moduleId >= dependencies_.size()) {
+        return;
+    }
+    for (uint32_t dependency : dependencies_[moduleId]) {
+        edges_.erase(edgeKey(moduleId, dependency));
+        std::vector<uint32_t>& dependents = dependents_[dependency];
+        dependents.erase(std::find(dependents.begin(), dependents.end(), moduleId));
+    }
+    dependencies_[moduleId].clear();
+}
+
+std::vector<uint32_t> DependencyGraph::transitiveDependents(const std::vector<uint32_t>& moduleIds) const {
+    std::vector<bool> visited;
+    std::vector<uint32_t> result;
+    std::vector<uint32_t> stack(moduleIds);
+    while (!stack.empty()) {
+        uint32_t moduleId = stack.back();
+        stack.pop_back();
+        if (moduleId >= visited.size()) {
+            visited.resize(moduleId + 1, false);
+        }
+        if (visited[moduleId]) {
+            continue;
+        }
+        visited[moduleId] = true;
+        result.push_back(moduleId);
+        for (uint32_t dependent : dependents(moduleId)) {
+            stack.push_back(dependent);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+const std::vector<uint32_t>& DependencyGraph::dependencies(uint32_t moduleId) const {
+    return moduleId < dependencies_.size() ? dependencies_[moduleId] : kNoDependencies;
+}
+
+void DependencyGraph::setLoadTime(uint32_t moduleId, int64_t nanoseconds) {
+    if (moduleId >= loadTimes_.size()) {
+        loadTimes_.resize(moduleId + 1, 0);
+    }
+    loadTimes_[moduleId] = nanoseconds;
+}
+
+void DependencyGraph::setLoadSpan(uint32_t moduleId, int64_t start, int64_t end) {
+    setLoadTime(moduleId, end - start);
+    if (moduleId >= loadStarts_.size()) {
+        loadStarts_.resize(moduleId + 1, 0);
+    }
+    loadStarts_[moduleId] = start;
+}
+
+void DependencyGraph::clear() {
+    dependencies_.clear();
+    dependents_.clear();
+    edges_.clear();
+    loadTimes_.clear();
+    loadStarts_.clear();
+}
+
+void DependencyGraph::installView(v8::Isolate* isolate, v8::Local<v8::ObjectTemplate> moduleTemplate) {
+    moduleTemplate->SetAccessor(registry_.dependenciesKey(isolate), dependenciesGetter, nullptr,
+                                v8::Local<v8::Value>(), v8::DEFAULT, v8::ReadOnly);
+}
+
+void DependencyGraph::dependenciesGetter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    DependencyGraph* graph = from(isolate);
+    uint32_t moduleId = ModuleRegistry::moduleId(info.Holder());
+    const std::vector<uint32_t>& dependencies = graph->dependencies(moduleId);
+    // 每次读取都按邻接表生成新的数组，数组只是依赖图的快照
+    std::vector<v8::Local<v8::Value>> uris;
+    uris.reserve(dependencies.size());
+    for (uint32_t dependency : dependencies) {
+        uris.push_back(newString(isolate, graph->registry_.paths().path(graph->registry_.pathId(dependency))));
+    }
+    info.GetReturnValue().Set(v8::Array::New(isolate, uris.data(), uris.size()));
+}
+
+v8::Local<v8::Object> DependencyGraph::toObject(v8::Isolate* isolate, v8::Local<v8::Context> context) const {
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::String> idKey = v8::String::NewFromUtf8Literal(isolate, "id");
+    v8::Local<v8::String> uriKey = registry_.uriKey(isolate);
+    v8::Local<v8::String> loadTimeKey = v8::String::NewFromUtf8Literal(isolate, "loadTime");
+    v8::Local<v8::String> dependenciesKey = registry_.dependenciesKey(isolate);
+    v8::Local<v8::Array> modules = v8::Array::New(isolate);
+    uint32_t index = 0;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        // 被驱逐、还没有重新加载的模块不在图中
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        const std::vector<uint32_t>& dependencies = this->dependencies(moduleId);
+        std::vector<v8::Local<v8::Value>> ids;
+        ids.reserve(dependencies.size());
+        for (uint32_t dependency : dependencies) {
+            if (registry_.loaded(dependency)) {
+                ids.push_back(v8::Integer::NewFromUnsigned(isolate, dependency));
+            }
+        }
+        v8::Local<v8::Object> module = v8::Object::New(isolate);
+        module->Set(context, idKey, v8::Integer::NewFromUnsigned(isolate, moduleId)).FromJust();
+        module->Set(context, uriKey, newString(isolate, registry_.paths().path(registry_.pathId(moduleId)))).FromJust();
+        // 毫秒
+        module->Set(context, loadTimeKey, v8::Number::New(isolate, loadTime(moduleId) / 1e6)).FromJust();
+        module->Set(context, dependenciesKey, v8::Array::New(isolate, ids.data(), ids.size())).FromJust();
+        modules->Set(context, index++, module).FromJust();
+    }
+    v8::Local<v8::Object> graph = v8::Object::New(isolate);
+    graph->Set(context, v8::String::NewFromUtf8Literal(isolate, "modules"), modules).FromJust();
+    return handleScope.Escape(graph);
+}
+
+void DependencyGraph::writeJson(std::ostream& out) const {
+    out << "{\"modules\":[";
+    bool firstModule = true;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        // 被驱逐、还没有重新加载的模块不输出
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        out << (firstModule ? "" : ",") << "{\"id\":" << moduleId << ",\"uri\":";
+        firstModule = false;
+        writeQuoted(out, registry_.paths().path(registry_.pathId(moduleId)));
+        out << ",\"loadTime\":" << loadTime(moduleId) / 1e6 << ",\"dependencies\":[";
+        bool firstDependency = true;
+        for (uint32_t dependency : dependencies(moduleId)) {
+            if (registry_.loaded(dependency)) {
+                out << (firstDependency ? "" : ",") << dependency;
+                firstDependency = false;
+            }
+        }
+        out << "]}";
+    }
+    out << "]}" << std::endl;
+}
+
+void DependencyGraph::writeDot(std::ostream& out) const {
+    out << "digraph modules {" << std::endl;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        out << "  m" << moduleId << " [label=";
+        writeQuoted(out, registry_.paths().path(registry_.pathId(moduleId)));
+        out << ", loadTime=" << loadTime(moduleId) / 1e6 << "];" << std::endl;
+    }
+    for (uint32_t moduleId = 0; moduleId < dependencies_.size(); ++moduleId) {
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        for (uint32_t dependency : dependencies_[moduleId]) {
+            if (registry_.loaded(dependency)) {
+                out << "  m" << moduleId << " -> m" << dependency << ";" << std::endl;
+            }
+        }
+    }
+    out << "}" << std::endl;
+}
+
+v8::Local<v8::Array> DependencyGraph::exportGraph(v8::Isolate* isolate, v8::Local<v8::Context> context) const {
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::Array> graph = v8::Array::New(isolate);
+    uint32_t index = 0;
+    graph->Set(context, index++, v8::Integer::NewFromUnsigned(isolate, static_cast<uint32_t>(registry_.size()))).FromJust();
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        graph->Set(context, index++, v8::Number::New(isolate, static_cast<double>(loadTime(moduleId)))).FromJust();
+    }
+    for (uint32_t moduleId = 0; moduleId < dependencies_.size(); ++moduleId) {
+        for (uint32_t dependency : dependencies_[moduleId]) {
+            graph->Set(context, index++, v8::Integer::NewFromUnsigned(isolate, moduleId)).FromJust();
+            graph->Set(context, index++, v8::Integer::NewFromUnsigned(isolate, dependency)).FromJust();
+        }
+    }
+    return handleScope.Escape(graph);
+}
+
+void DependencyGraph::importGraph(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Array> graph) {
+    clear();
+    uint32_t length = graph->Length();
+    if (length == 0) {
+        return;
+    }
+    uint32_t moduleCount = graph->Get(context, 0).ToLocalChecked().As<v8::Uint32>()->Value();
+    uint32_t index = 1;
+    for (uint32_t moduleId = 0; moduleId < moduleCount && index < length; ++moduleId, ++index) {
+        setLoadTime(moduleId, static_cast<int64_t>(graph->Get(context, index).ToLocalChecked().As<v8::Number>()->Value()));
+    }
+    for (; index + 1 < length; index += 2) {
+        addEdge(graph->Get(context, index).ToLocalChecked().As<v8::Uint32>()->Value(),
+                graph->Get(context, index + 1).ToLocalChecked().As<v8::Uint32>()->Value());
+    }
+}
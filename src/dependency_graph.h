@@ -0,0 +1,161 @@
+#ifndef COMMONJS_SERVER_DEPENDENCY_GRAPH_H
+#define COMMONJS_SERVER_DEPENDENCY_GRAPH_H
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_set>
+#include <vector>
+#include "v8.h"
+#include "module_registry.h"
+
+// isolate 数据槽中保存依赖图的位置
+const uint32_t kDependencyGraphSlot = 2;
+
+/**
+ * 模块依赖图。以模块 id 为下标保存正向和反向邻接表，边的去重用 (父模块 id, 子模块 id) 组成的 64 位 key 做 hash 查找，
+ * 添加一条边是 O(1)。module.dependencies 是 module 模板上的访问器，读取时才按邻接表生成模块路径数组。
+ */
+class DependencyGraph {
+public:
+    explicit DependencyGraph(ModuleRegistry& registry) : registry_(registry) {}
+
+    /**
+     * 把依赖图挂到 isolate 上，module.dependencies 的访问器通过 isolate 找到依赖图
+     * @param isolate
+     */
+    void attach(v8::Isolate* isolate);
+
+    static DependencyGraph* from(v8::Isolate* isolate);
+
+    /**
+     * 添加一条依赖边，重复的边忽略
+     * @param from 父模块 id
+     * @param to 被依赖的模块 id
+     * @return 是否是新的边
+     */
+    bool addEdge(uint32_t from, uint32_t to);
+
+    /**
+     * 模块直接依赖的模块 id，按首次 require 的顺序排列
+     * @param moduleId
+     * @return
+     */
+    const std::vector<uint32_t>& dependencies(uint32_t moduleId) const;
+
+    /**
+     * 直接依赖该模块的模块 id
+     * @param moduleId
+     * @return
+     */
+    const std::vector<uint32_t>& dependents(uint32_t moduleId) const;
+
+    /**
+     * 删除模块的所有出边，模块重新加载时由新的 require 重建
+     * @param moduleId
+     */
+    void removeDependencies(uint32_t moduleId);
+
+    /**
+     * 沿反向边收集模块及其所有传递依赖者
+     * @param moduleIds
+     * @return 按模块 id 升序排列
+     */
+    std::vector<uint32_t> transitiveDependents(const std::vector<uint32_t>& moduleIds) const;
+
+    /**
+     * 记录模块的加载耗时(包含依赖的加载)
+     * @param moduleId
+     * @param nanoseconds
+     */
+    void setLoadTime(uint32_t moduleId, int64_t nanoseconds);
+
+    int64_t loadTime(uint32_t moduleId) const {
+        return moduleId < loadTimes_.size() ? loadTimes_[moduleId] : 0;
+    }
+
+    /**
+     * 记录模块的加载区间，加载耗时为区间长度。嵌套的 require 在父模块的区间之内，由此可以还原加载树
+     * @param moduleId
+     * @param start 开始时间(steady_clock 纳秒)
+     * @param end 结束时间(steady_clock 纳秒)
+     */
+    void setLoadSpan(uint32_t moduleId, int64_t start, int64_t end);
+
+    /**
+     * 模块加载的开始时间，没有记录时为 0。快照中只保存加载耗时
+     * @param moduleId
+     * @return
+     */
+    int64_t loadStart(uint32_t moduleId) const {
+        return moduleId < loadStarts_.size() ? loadStarts_[moduleId] : 0;
+    }
+
+    size_t edgeCount() const { return edges_.size(); }
+
+    void clear();
+
+    /**
+     * 在 module 对象的模板上安装 dependencies 访问器，访问器通过 module 对象的内部字段找到模块 id
+     * @param isolate
+     * @param moduleTemplate
+     */
+    void installView(v8::Isolate* isolate, v8::Local<v8::ObjectTemplate> moduleTemplate);
+
+    /**
+     * 生成 require.graph() 的结果：{ modules: [{ id, uri, loadTime, dependencies: [id...] }] }。
+     * 热重载驱逐之后没有重新加载的模块不在结果中，JSON 和 dot 输出同样跳过
+     * @param isolate
+     * @param context
+     * @return
+     */
+    v8::Local<v8::Object> toObject(v8::Isolate* isolate, v8::Local<v8::Context> context) const;
+
+    /**
+     * 以 JSON 格式输出，结构与 require.graph() 相同
+     * @param out
+     */
+    void writeJson(std::ostream& out) const;
+
+    /**
+     * 以 graphviz dot 格式输出
+     * @param out
+     */
+    void writeDot(std::ostream& out) const;
+
+    /**
+     * 把依赖边和加载耗时导出成数组，用于写入快照：[模块数, 耗时..., from, to, from, to...]
+     * @param isolate
+     * @param context
+     * @return
+     */
+    v8::Local<v8::Array> exportGraph(v8::Isolate* isolate, v8::Local<v8::Context> context) const;
+
+    /**
+     * 从快照中的数组恢复依赖图，模块 id 与快照中的注册表一致
+     * @param isolate
+     * @param context
+     * @param graph
+     */
+    void importGraph(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Array> graph);
+
+    // module.dependencies 的访问器，需要登记到快照的 external references 中
+    static void dependenciesGetter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Value>& info);
+
+private:
+    static uint64_t edgeKey(uint32_t from, uint32_t to) {
+        return static_cast<uint64_t>(from) << 32 | to;
+    }
+
+    ModuleRegistry& registry_;
+    // 模块 id -> 直接依赖的模块 id
+    std::vector<std::vector<uint32_t>> dependencies_;
+    // 模块 id -> 直接依赖该模块的模块 id
+    std::vector<std::vector<uint32_t>> dependents_;
+    std::unordered_set<uint64_t> edges_;
+    // 模块 id -> 加载耗时(纳秒)
+    std::vector<int64_t> loadTimes_;
+    // 模块 id -> 加载开始时间(纳秒)
+    std::vector<int64_t> loadStarts_;
+};
+
+#endif //COMMONJS_SERVER_DEPENDENCY_GRAPH_H
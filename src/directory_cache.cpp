@@ -0,0 +1,254 @@
+#include "directory_cache.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace {
+
+/**
+ * 只认识 package.json 需要的部分 JSON：跳过任意值，解析字符串
+ */
+class JsonScanner {
+public:
+    explicit JsonScanner(const std::string& json) : current_(json.data()), end_(json.data() + json.size()) {}
+
+    void skipSpace() {
+        while (current_ < end_ && (*current_ == ' ' || *current_ == '\t' || *current_ == '\r' || *current_ == '\n')) {
+            ++current_;
+        }
+    }
+
+    bool consume(char ch) {
+        skipSpace();
+        if (current_ < end_ && *current_ == ch) {
+            ++current_;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char ch) {
+        skipSpace();
+        return current_ < end_ && *current_ == ch;
+    }
+
+    /**
+     * 解析字符串，out 为 nullptr 时只跳过
+     * @param out
+     * @return
+     */
+    bool parseString(std::string* out) {
+        if (!consume('"')) {
+            return false;
+        }
+        while (current_ < end_) {
+            char ch = *current_++;
+            if (ch == '"') {
+                return true;
+            }
+            if (ch != '\\') {
+                if (out != nullptr) {
+                    out->push_back(ch);
+                }
+                continue;
+            }
+            if (current_ >= end_) {
+                return false;
+            }
+            char escaped = *current_++;
+            if (escaped == 'u') {
+                if (end_ - current_ < 4) {
+                    return false;
+                }
+                unsigned int code = 0;
+                for (int index = 0; index < 4; ++index) {
+                    char digit = *current_++;
+                    code <<= 4;
+                    if (digit >= '0' && digit <= '9') {
+                        code |= digit - '0';
+                    } else if (digit >= 'a' && digit <= 'f') {
+                        code |= digit - 'a' + 10;
+                    } else if (digit >= 'A' && digit <= 'F') {
+                        code |= digit - 'A' + 10;
+                    } else {
+                        return false;
+                    }
+                }
+                if (out != nullptr) {
+                    appendUtf8(*out, code);
+                }
+                continue;
+            }
+            if (out != nullptr) {
+                switch (escaped) {
+                    case 'b': out->push_back('\b'); break;
+                    case 'f': out->push_back('\f'); break;
+                    case 'n': out->push_back('\n'); break;
+                    case 'r': out->push_back('\r'); break;
+                    case 't': out->push_back('\t'); break;
+                    default: out->push_back(escaped); break;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * 跳过一个任意的值
+     * @return
+     */
+    bool skipValue() {
+        skipSpace();
+        if (current_ >= end_) {
+            return false;
+        }
+        if (*current_ == '"') {
+            return parseString(nullptr);
+        }
+        if (*current_ == '{' || *current_ == '[') {
+            int depth = 0;
+            while (current_ < end_) {
+                if (*current_ == '"') {
+                    if (!parseString(nullptr)) {
+                        return false;
+                    }
+                    continue;
+                }
+                char ch = *current_++;
+                if (ch == '{' || ch == '[') {
+                    ++depth;
+                } else if ((ch == '}' || ch == ']') && --depth == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        // 数字、true、false、null
+        const char* start = current_;
+        while (current_ < end_ && *current_ != ',' && *current_ != '}' && *current_ != ']' &&
+               *current_ != ' ' && *current_ != '\t' && *current_ != '\r' && *current_ != '\n') {
+            ++current_;
+        }
+        return current_ != start;
+    }
+
+private:
+    static void appendUtf8(std::string& out, unsigned int code) {
+        if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+
+    const char* current_;
+    const char* end_;
+};
+
+}
+
+bool parsePackageMain(const std::string& json, std::string& main) {
+    JsonScanner scanner(json);
+    if (!scanner.consume('{')) {
+        return false;
+    }
+    if (scanner.consume('}')) {
+        return false;
+    }
+    do {
+        std::string key;
+        if (!scanner.parseString(&key) || !scanner.consume(':')) {
+            return false;
+        }
+        if (key == "main" && scanner.peek('"')) {
+            main.clear();
+            return scanner.parseString(&main);
+        }
+        if (!scanner.skipValue()) {
+            return false;
+        }
+    } while (scanner.consume(','));
+    return false;
+}
+
+DirectoryCache::Directory& DirectoryCache::directory(const std::string& dir) {
+    auto iterator = directories_.find(dir);
+    if (iterator != directories_.end()) {
+        return iterator->second;
+    }
+    Directory& directory = directories_[dir];
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) {
+        // 不存在的目录也缓存下来，node_modules 的逐级查找大部分都是这种情况
+        return directory;
+    }
+    directory.exists = true;
+    int dirFd = dirfd(handle);
+    while (struct dirent* entry = readdir(handle)) {
+        std::string name(entry->d_name);
+        if (name == "." || name == "..") {
+            continue;
+        }
+        EntryType type = EntryType::kNone;
+        if (entry->d_type == DT_REG) {
+            type = EntryType::kFile;
+        } else if (entry->d_type == DT_DIR) {
+            type = EntryType::kDirectory;
+        } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            // 符号链接和不支持 d_type 的文件系统需要 stat 目标
+            struct stat fileStat;
+            if (fstatat(dirFd, entry->d_name, &fileStat, 0) == 0) {
+                type = S_ISREG(fileStat.st_mode) ? EntryType::kFile :
+                       S_ISDIR(fileStat.st_mode) ? EntryType::kDirectory : EntryType::kNone;
+            }
+        }
+        if (type != EntryType::kNone) {
+            directory.entries.emplace(std::move(name), type);
+        }
+    }
+    closedir(handle);
+    return directory;
+}
+
+DirectoryCache::EntryType DirectoryCache::stat(const std::string& path) {
+    if (path == "/") {
+        return EntryType::kDirectory;
+    }
+    size_t index = path.find_last_of('/');
+    if (index == std::string::npos) {
+        return EntryType::kNone;
+    }
+    Directory& parent = directory(index == 0 ? std::string("/") : path.substr(0, index));
+    auto iterator = parent.entries.find(path.substr(index + 1));
+    return iterator == parent.entries.end() ? EntryType::kNone : iterator->second;
+}
+
+const std::string& DirectoryCache::packageMain(const std::string& dir) {
+    Directory& directory = this->directory(dir);
+    if (directory.packageLoaded) {
+        return directory.main;
+    }
+    directory.packageLoaded = true;
+    auto iterator = directory.entries.find("package.json");
+    if (iterator == directory.entries.end() || iterator->second != EntryType::kFile) {
+        return directory.main;
+    }
+    std::ifstream in(dir + "/package.json", std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    if (!parsePackageMain(content.str(), directory.main)) {
+        directory.main.clear();
+    }
+    return directory.main;
+}
+
+void DirectoryCache::invalidate(const std::string& dir) {
+    directories_.erase(dir);
+}
@@ -0,0 +1,61 @@
+#ifndef COMMONJS_SERVER_DIRECTORY_CACHE_H
+#define COMMONJS_SERVER_DIRECTORY_CACHE_H
+
+#include <string>
+#include <unordered_map>
+
+/**
+ * 目录项缓存。每个目录第一次被访问时用 readdir 读出全部目录项，
+ * 之后判断文件是否存在只需要 hash 查找，不再为每个候选路径调用 open/stat。
+ * 不存在的目录同样会被记住(负缓存)。package.json 的 main 字段也缓存在所属目录上。
+ */
+class DirectoryCache {
+public:
+    enum class EntryType {
+        kNone,
+        kFile,
+        kDirectory
+    };
+
+    /**
+     * 查询路径的类型
+     * @param path 规范化的绝对路径
+     * @return 不存在时返回 kNone
+     */
+    EntryType stat(const std::string& path);
+
+    /**
+     * 目录下 package.json 的 main 字段
+     * @param dir 规范化的绝对路径
+     * @return 没有 package.json 或者没有 main 字段时返回空字符串
+     */
+    const std::string& packageMain(const std::string& dir);
+
+    /**
+     * 丢弃目录的缓存，下次访问时重新读取
+     * @param dir
+     */
+    void invalidate(const std::string& dir);
+
+private:
+    struct Directory {
+        bool exists = false;
+        std::unordered_map<std::string, EntryType> entries;
+        bool packageLoaded = false;
+        std::string main;
+    };
+
+    Directory& directory(const std::string& dir);
+
+    std::unordered_map<std::string, Directory> directories_;
+};
+
+/**
+ * 从 package.json 的内容中取出顶层的 main 字段
+ * @param json
+ * @param main 输出 main 字段
+ * @return 是否找到字符串类型的 main 字段
+ */
+bool parsePackageMain(const std::string& json, std::string& main);
+
+#endif //COMMONJS_SERVER_DIRECTORY_CACHE_H
@@ -0,0 +1,47 @@
+#include "es_module.h"
+
+v8::MaybeLocal<v8::Module> EsModuleMap::find(v8::Isolate* isolate, uint32_t pathId) const {
+    auto iterator = modules_.find(pathId);
+    if (iterator == modules_.end()) {
+        return v8::MaybeLocal<v8::Module>();
+    }
+    return iterator->second.Get(isolate);
+}
+
+void EsModuleMap::add(v8::Isolate* isolate, uint32_t pathId, v8::Local<v8::Module> module) {
+    remove(isolate, pathId);
+    modules_[pathId].Reset(isolate, module);
+    byHash_.emplace(module->GetIdentityHash(), pathId);
+}
+
+uint32_t EsModuleMap::pathId(v8::Isolate* isolate, v8::Local<v8::Module> module) const {
+    auto range = byHash_.equal_range(module->GetIdentityHash());
+    for (auto iterator = range.first; iterator != range.second; ++iterator) {
+        auto entry = modules_.find(iterator->second);
+        if (entry != modules_.end() && entry->second.Get(isolate) == module) {
+            return iterator->second;
+        }
+    }
+    return kInvalidPathId;
+}
+
+void EsModuleMap::remove(v8::Isolate* isolate, uint32_t pathId) {
+    auto iterator = modules_.find(pathId);
+    if (iterator == modules_.end()) {
+        return;
+    }
+    v8::HandleScope handleScope(isolate);
+    auto range = byHash_.equal_range(iterator->second.Get(isolate)->GetIdentityHash());
+    for (auto entry = range.first; entry != range.second; ++entry) {
+        if (entry->second == pathId) {
+            byHash_.erase(entry);
+            break;
+        }
+    }
+    modules_.erase(iterator);
+}
+
+void EsModuleMap::clear() {
+    modules_.clear();
+    byHash_.clear();
+}
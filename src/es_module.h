@@ -0,0 +1,59 @@
+#ifndef COMMONJS_SERVER_ES_MODULE_H
+#define COMMONJS_SERVER_ES_MODULE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include "v8.h"
+#include "path_resolver.h"
+
+/**
+ * ES 模块表。以路径 id 保存编译好的 v8::Module，同一路径在整个 isolate 中只有一个模块实例；
+ * v8 的解析回调只给出 referrer 模块，用模块的 identity hash 反查它的路径。
+ * import CommonJS 模块时保存的是包装 exports 的合成模块。
+ */
+class EsModuleMap {
+public:
+    /**
+     * 查找模块
+     * @param isolate
+     * @param pathId 模块绝对路径 id
+     * @return 没有编译过时返回空
+     */
+    v8::MaybeLocal<v8::Module> find(v8::Isolate* isolate, uint32_t pathId) const;
+
+    /**
+     * 添加模块，同一路径已经存在时替换
+     * @param isolate
+     * @param pathId
+     * @param module
+     */
+    void add(v8::Isolate* isolate, uint32_t pathId, v8::Local<v8::Module> module);
+
+    /**
+     * 模块的路径 id
+     * @param isolate
+     * @param module
+     * @return 不在表中时返回 kInvalidPathId
+     */
+    uint32_t pathId(v8::Isolate* isolate, v8::Local<v8::Module> module) const;
+
+    /**
+     * 移除模块，下次 import 时重新编译。用于热重载
+     * @param isolate
+     * @param pathId
+     */
+    void remove(v8::Isolate* isolate, uint32_t pathId);
+
+    /**
+     * 释放所有模块。构建快照之前和 isolate 销毁之前必须调用
+     */
+    void clear();
+
+private:
+    // 路径 id -> 模块
+    std::unordered_map<uint32_t, v8::Global<v8::Module>> modules_;
+    // identity hash -> 路径 id，hash 可能冲突
+    std::unordered_multimap<int, uint32_t> byHash_;
+};
+
+#endif //COMMONJS_SERVER_ES_MODULE_H
@@ -0,0 +1,220 @@
+#include "event_loop.h"
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "libplatform/libplatform.h"
+
+namespace {
+
+// 一次 epoll_wait 最多取出的事件数
+const int kMaxEvents = 64;
+
+/**
+ * wakeAfter 的参数，定时器只能在 isolate 线程上添加，先投递到完成队列
+ */
+struct DelayedWake {
+    EventLoop* loop;
+    int64_t delayMillis;
+};
+
+int64_t nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+EventLoop::~EventLoop() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool EventLoop::start() {
+    if (fd_ >= 0) {
+        return true;
+    }
+    if (!completions_.open()) {
+        return false;
+    }
+    fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (fd_ < 0) {
+        return false;
+    }
+    // 完成队列的 eventfd 不是句柄，不会让循环继续运行
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = completions_.fd();
+    return epoll_ctl(fd_, EPOLL_CTL_ADD, completions_.fd(), &event) == 0;
+}
+
+bool EventLoop::add(int fd, uint32_t events, IoCallback callback, bool referenced) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (fd_ < 0 || handles_.count(fd) || epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return false;
+    }
+    handles_[fd] = Handle{ std::move(callback), referenced };
+    if (referenced) {
+        referencedHandles_++;
+    }
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    return handles_.count(fd) && epoll_ctl(fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    auto found = handles_.find(fd);
+    if (found == handles_.end()) {
+        return;
+    }
+    if (found->second.referenced) {
+        referencedHandles_--;
+    }
+    handles_.erase(found);
+    epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void EventLoop::setReferenced(int fd, bool referenced) {
+    auto found = handles_.find(fd);
+    if (found == handles_.end() || found->second.referenced == referenced) {
+        return;
+    }
+    found->second.referenced = referenced;
+    if (referenced) {
+        referencedHandles_++;
+    } else {
+        referencedHandles_--;
+    }
+}
+
+uint64_t EventLoop::setTimer(int64_t delayMillis, TimerCallback callback, bool referenced) {
+    uint64_t timerId = nextTimerId_++;
+    int64_t deadline = nowMillis() + (delayMillis > 0 ? delayMillis : 0);
+    timers_.emplace(TimerKey(deadline, timerId), Timer{ std::move(callback), referenced });
+    timerDeadlines_[timerId] = deadline;
+    if (referenced) {
+        referencedTimers_++;
+    }
+    return timerId;
+}
+
+void EventLoop::clearTimer(uint64_t timerId) {
+    auto found = timerDeadlines_.find(timerId);
+    if (found == timerDeadlines_.end()) {
+        return;
+    }
+    auto timer = timers_.find(TimerKey(found->second, timerId));
+    if (timer->second.referenced) {
+        referencedTimers_--;
+    }
+    timers_.erase(timer);
+    timerDeadlines_.erase(found);
+}
+
+void EventLoop::wakeAfter(int64_t delayMillis) {
+    post(addWakeTimer, new DelayedWake{ this, delayMillis });
+}
+
+void EventLoop::addWakeTimer(void* data) {
+    std::unique_ptr<DelayedWake> wake(static_cast<DelayedWake*>(data));
+    // 定时器本身什么也不做，到期时 epoll_wait 返回，本轮末尾执行平台任务
+    wake->loop->setTimer(wake->delayMillis, []() {}, false);
+}
+
+int EventLoop::nextTimeout() const {
+    if (timers_.empty()) {
+        return -1;
+    }
+    int64_t timeout = timers_.begin()->first.first - nowMillis();
+    return timeout > 0 ? static_cast<int>(timeout) : 0;
+}
+
+void EventLoop::runTimers(v8::Isolate* isolate) {
+    int64_t now = nowMillis();
+    // 回调中添加的定时器即使已经到期也留到下一轮，避免 0 延迟的定时器饿死 I/O
+    uint64_t lastTimerId = nextTimerId_;
+    auto timer = timers_.begin();
+    while (timer != timers_.end() && timer->first.first <= now) {
+        if (timer->first.second >= lastTimerId) {
+            ++timer;
+            continue;
+        }
+        Timer fired = std::move(timer->second);
+        timerDeadlines_.erase(timer->first.second);
+        timers_.erase(timer);
+        if (fired.referenced) {
+            referencedTimers_--;
+        }
+        {
+            v8::HandleScope handleScope(isolate);
+            fired.callback();
+        }
+        isolate->PerformMicrotaskCheckpoint();
+        // 回调可能取消了其他定时器，重新从头查找
+        timer = timers_.begin();
+    }
+}
+
+void EventLoop::runCompletions(v8::Isolate* isolate) {
+    std::vector<CompletionQueue::Completion> completed;
+    completions_.take(completed);
+    for (const CompletionQueue::Completion& completion : completed) {
+        {
+            v8::HandleScope handleScope(isolate);
+            completion.callback(completion.data);
+        }
+        isolate->PerformMicrotaskCheckpoint();
+    }
+}
+
+bool EventLoop::run(v8::Isolate* isolate) {
+    if (fd_ < 0) {
+        return false;
+    }
+    struct epoll_event events[kMaxEvents];
+    while (alive()) {
+        int ready = epoll_wait(fd_, events, kMaxEvents, nextTimeout());
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        for (int index = 0; index < ready; ++index) {
+            int fd = events[index].data.fd;
+            if (fd == completions_.fd()) {
+                runCompletions(isolate);
+                continue;
+            }
+            // 同一轮中前面的回调可能已经注销了这个句柄
+            auto found = handles_.find(fd);
+            if (found == handles_.end()) {
+                continue;
+            }
+            // 回调可能注销自己，先复制一份
+            IoCallback callback = found->second.callback;
+            {
+                v8::HandleScope handleScope(isolate);
+                callback(events[index].events);
+            }
+            isolate->PerformMicrotaskCheckpoint();
+        }
+        runTimers(isolate);
+        // 平台的前台任务(GC、wasm 分层编译的收尾等)在每轮末尾执行，不等待
+        if (platform_ != nullptr) {
+            while (v8::platform::PumpMessageLoop(platform_, isolate)) {
+                isolate->PerformMicrotaskCheckpoint();
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,175 @@
+#ifndef COMMONJS_SERVER_EVENT_LOOP_H
+#define COMMONJS_SERVER_EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include "v8.h"
+#include "completion_queue.h"
+
+/**
+ * 基于 epoll 的事件循环。套接字、inotify 等文件描述符注册为句柄，可读写时调用句柄的回调；
+ * 其他线程的结果通过无锁的完成队列投递，队列的 eventfd 也注册在 epoll 上；定时器按到期时间排序，
+ * 最近的到期时间作为 epoll_wait 的超时。
+ * 每个宏任务(一次句柄回调、一个完成的任务或者一个到期的定时器)执行之后立即清空微任务队列。
+ * 没有被引用的句柄、定时器和进行中的后台任务时循环退出。
+ */
+class EventLoop {
+public:
+    /**
+     * 句柄回调
+     * @param events 就绪的 epoll 事件
+     */
+    typedef std::function<void(uint32_t events)> IoCallback;
+
+    typedef std::function<void()> TimerCallback;
+
+    EventLoop() = default;
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * 创建 epoll 实例和完成队列的 eventfd
+     * @return 是否成功
+     */
+    bool start();
+
+    /**
+     * 设置平台，每轮循环执行平台上的前台任务
+     * @param platform
+     */
+    void setPlatform(v8::Platform* platform) { platform_ = platform; }
+
+    /**
+     * 注册文件描述符
+     * @param fd
+     * @param events 关心的 epoll 事件
+     * @param callback
+     * @param referenced 为 false 时句柄不会让循环继续运行
+     * @return 是否成功
+     */
+    bool add(int fd, uint32_t events, IoCallback callback, bool referenced = true);
+
+    /**
+     * 修改关心的事件
+     * @param fd
+     * @param events
+     * @return 是否成功
+     */
+    bool modify(int fd, uint32_t events);
+
+    /**
+     * 注销文件描述符，可以在回调中调用。文件描述符由调用者关闭
+     * @param fd
+     */
+    void remove(int fd);
+
+    void setReferenced(int fd, bool referenced);
+
+    /**
+     * 添加一次性定时器
+     * @param delayMillis 延迟(毫秒)
+     * @param callback
+     * @param referenced 为 false 时定时器不会让循环继续运行
+     * @return 定时器 id
+     */
+    uint64_t setTimer(int64_t delayMillis, TimerCallback callback, bool referenced = true);
+
+    /**
+     * 取消还没有到期的定时器，已经到期或者不存在时忽略
+     * @param timerId
+     */
+    void clearTimer(uint64_t timerId);
+
+    /**
+     * 投递宏任务，可以在任意线程调用。任务在 isolate 线程上执行
+     * @param callback
+     * @param data
+     */
+    void post(CompletionQueue::Callback callback, void* data) { completions_.push(callback, data); }
+
+    /**
+     * 唤醒循环，让它在本轮末尾执行平台的前台任务。可以在任意线程调用
+     */
+    void wake() { completions_.signal(); }
+
+    /**
+     * 在一段时间之后唤醒循环，用于平台的延迟任务。可以在任意线程调用，唤醒不会让循环继续运行
+     * @param delayMillis
+     */
+    void wakeAfter(int64_t delayMillis);
+
+    /**
+     * 引用一次循环，进行中的后台任务完成之前循环不会退出
+     */
+    void ref() { refs_++; }
+
+    void unref() { refs_--; }
+
+    // 是否还有被引用的句柄、定时器或者后台任务
+    bool alive() const { return refs_ > 0 || referencedHandles_ > 0 || referencedTimers_ > 0; }
+
+    /**
+     * 运行循环，直到没有被引用的句柄、定时器和后台任务
+     * @param isolate
+     * @return epoll 出错时返回 false
+     */
+    bool run(v8::Isolate* isolate);
+
+private:
+    struct Handle {
+        IoCallback callback;
+        bool referenced;
+    };
+
+    struct Timer {
+        TimerCallback callback;
+        bool referenced;
+    };
+
+    // (到期时间, 定时器 id)，到期时间相同时按添加顺序
+    typedef std::pair<int64_t, uint64_t> TimerKey;
+
+    /**
+     * 距离最近的定时器到期的毫秒数，没有定时器时为 -1
+     * @return
+     */
+    int nextTimeout() const;
+
+    /**
+     * 执行所有到期的定时器
+     * @param isolate
+     */
+    void runTimers(v8::Isolate* isolate);
+
+    /**
+     * 执行完成队列中的所有任务
+     * @param isolate
+     */
+    void runCompletions(v8::Isolate* isolate);
+
+    /**
+     * 在 isolate 线程上添加 wakeAfter 的定时器
+     * @param data DelayedWake
+     */
+    static void addWakeTimer(void* data);
+
+    int fd_ = -1;
+    v8::Platform* platform_ = nullptr;
+    CompletionQueue completions_;
+    // 文件描述符 -> 句柄
+    std::unordered_map<int, Handle> handles_;
+    std::map<TimerKey, Timer> timers_;
+    // 定时器 id -> 到期时间
+    std::unordered_map<uint64_t, int64_t> timerDeadlines_;
+    uint64_t nextTimerId_ = 1;
+    size_t referencedHandles_ = 0;
+    size_t referencedTimers_ = 0;
+    size_t refs_ = 0;
+};
+
+#endif //COMMONJS_SERVER_EVENT_LOOP_H
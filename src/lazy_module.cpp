@@ -0,0 +1,231 @@
+#include "lazy_module.h"
+
+namespace {
+
+/**
+ * 占位对象的 handler 工厂。每个上下文只编译一次，返回的状态对象保存在快照里：
+ * { generation, newStub(target, path, parentPath) }。
+ * 每个占位对象的 handler 以共享的陷阱对象为原型，自身只保存路径和缓存的 exports，
+ * 陷阱通过 this 取到缓存，之后的访问只是一次比较加一次 Reflect 调用，不经过原生代码也不分配内存。
+ * generation 变化(热重载驱逐了模块)之后缓存失效，下一次访问重新加载。
+ * exports 上不可配置的属性和不可扩展的状态同步到 target 上，Proxy 的不变式检查与 exports 一致；
+ * 同步过去的属性受不变式约束，冻结过的 exports 重新加载时必须保持这些属性不变
+ */
+const char kStubFactorySource[] = R"((function (load) {
+    'use strict';
+    const R = Reflect;
+    const state = { generation: 0, newStub: undefined };
+
+    function exportsOf(handler) {
+        if (handler.generation !== state.generation) {
+            handler.exports = load(handler.path, handler.parentPath);
+            handler.generation = state.generation;
+        }
+        return handler.exports;
+    }
+
+    // exports 上的属性不可配置，或者 target 已经不可扩展时，把属性同步到 target 上
+    function mirrorProperty(target, exports, key) {
+        const descriptor = R.getOwnPropertyDescriptor(exports, key);
+        if (descriptor !== undefined && (!descriptor.configurable || !R.isExtensible(target))) {
+            R.defineProperty(target, key, descriptor);
+        }
+    }
+
+    // exports 不可扩展时让 target 也不可扩展。不可扩展的 target 上必须恰好有 exports 的所有属性和同一个原型
+    function mirrorExtensibility(target, exports) {
+        if (R.isExtensible(exports) || !R.isExtensible(target)) {
+            return;
+        }
+        const keys = R.ownKeys(exports);
+        for (let index = 0; index < keys.length; ++index) {
+            R.defineProperty(target, keys[index], R.getOwnPropertyDescriptor(exports, keys[index]));
+        }
+        R.setPrototypeOf(target, R.getPrototypeOf(exports));
+        R.preventExtensions(target);
+    }
+
+    const traps = {
+        get(target, key, receiver) {
+            return R.get(exportsOf(this), key, receiver);
+        },
+        set(target, key, value, receiver) {
+            return R.set(exportsOf(this), key, value, receiver);
+        },
+        has(target, key) {
+            return R.has(exportsOf(this), key);
+        },
+        ownKeys(target) {
+            return R.ownKeys(exportsOf(this));
+        },
+        getPrototypeOf(target) {
+            return R.getPrototypeOf(exportsOf(this));
+        },
+        setPrototypeOf(target, prototype) {
+            return R.setPrototypeOf(exportsOf(this), prototype);
+        },
+        apply(target, thisArgument, args) {
+            return R.apply(exportsOf(this), thisArgument, args);
+        },
+        construct(target, args, newTarget) {
+            return R.construct(exportsOf(this), args, newTarget);
+        },
+        getOwnPropertyDescriptor(target, key) {
+            const exports = exportsOf(this);
+            const descriptor = R.getOwnPropertyDescriptor(exports, key);
+            if (descriptor !== undefined && !descriptor.configurable) {
+                mirrorProperty(target, exports, key);
+            }
+            return descriptor;
+        },
+        defineProperty(target, key, descriptor) {
+            const exports = exportsOf(this);
+            const result = R.defineProperty(exports, key, descriptor);
+            if (result) {
+                mirrorProperty(target, exports, key);
+            }
+            return result;
+        },
+        deleteProperty(target, key) {
+            const result = R.deleteProperty(exportsOf(this), key);
+            if (result) {
+                R.deleteProperty(target, key);
+            }
+            return result;
+        },
+        isExtensible(target) {
+            const exports = exportsOf(this);
+            const result = R.isExtensible(exports);
+            mirrorExtensibility(target, exports);
+            return result;
+        },
+        preventExtensions(target) {
+            const exports = exportsOf(this);
+            const result = R.preventExtensions(exports);
+            mirrorExtensibility(target, exports);
+            return result;
+        },
+    };
+
+    state.newStub = function (target, path, parentPath) {
+        return new Proxy(target, { __proto__: traps, path, parentPath, exports: undefined, generation: -1 });
+    };
+    return state;
+}))";
+
+v8::Local<v8::String> newString(v8::Isolate* isolate, const std::string& value) {
+    return v8::String::NewFromUtf8(isolate, value.data(), v8::NewStringType::kNormal,
+                                   static_cast<int>(value.size())).ToLocalChecked();
+}
+
+}
+
+void LazyModules::attach(v8::Isolate* isolate) {
+    isolate->SetData(kLazyModulesSlot, this);
+}
+
+LazyModules* LazyModules::from(v8::Isolate* isolate) {
+    return static_cast<LazyModules*>(isolate->GetData(kLazyModulesSlot));
+}
+
+void LazyModules::add(uint32_t pathId) {
+    if (pathId >= lazy_.size()) {
+        lazy_.resize(pathId + 1, false);
+    }
+    lazy_[pathId] = true;
+}
+
+void LazyModules::reset() {
+    state_.Reset();
+    targetTemplate_.Reset();
+}
+
+v8::Local<v8::Object> LazyModules::state(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    if (!state_.IsEmpty()) {
+        return state_.Get(isolate);
+    }
+    v8::Local<v8::Script> script = v8::Script::Compile(context, v8::String::NewFromUtf8Literal(isolate, kStubFactorySource)).ToLocalChecked();
+    v8::Local<v8::Function> factory = script->Run(context).ToLocalChecked().As<v8::Function>();
+    v8::Local<v8::Value> argv[] = { v8::Function::New(context, loadCallback).ToLocalChecked() };
+    v8::Local<v8::Object> state = factory->Call(context, v8::Undefined(isolate), 1, argv).ToLocalChecked().As<v8::Object>();
+    state_.Reset(isolate, state);
+    return state;
+}
+
+v8::Local<v8::Object> LazyModules::exportState(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    return state(isolate, context);
+}
+
+void LazyModules::importState(v8::Isolate* isolate, v8::Local<v8::Object> state) {
+    state_.Reset(isolate, state);
+}
+
+void LazyModules::invalidate(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    if (state_.IsEmpty()) {
+        return;
+    }
+    v8::HandleScope handleScope(isolate);
+    v8::Local<v8::Object> state = state_.Get(isolate);
+    v8::Local<v8::String> name = v8::String::NewFromUtf8Literal(isolate, "generation");
+    int32_t generation = state->Get(context, name).ToLocalChecked()->Int32Value(context).FromJust();
+    state->Set(context, name, v8::Integer::New(isolate, generation + 1)).FromJust();
+}
+
+v8::Local<v8::Object> LazyModules::newStub(v8::Isolate* isolate, v8::Local<v8::Context> context,
+                                           uint32_t pathId, uint32_t parentPathId, bool callable) {
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::Object> target;
+    if (callable) {
+        if (targetTemplate_.IsEmpty()) {
+            v8::Local<v8::ObjectTemplate> objectTemplate = v8::ObjectTemplate::New(isolate);
+            // 可调用的 target 让 Proxy 带有 [[Call]] 和 [[Construct]]，exports 是函数时占位对象可以直接调用或者 new。
+            // 与函数不同，它没有 prototype 等自有属性，不会和 exports 的属性冲突
+            objectTemplate->SetCallAsFunctionHandler(targetCall);
+            targetTemplate_.Reset(isolate, objectTemplate);
+        }
+        target = targetTemplate_.Get(isolate)->NewInstance(context).ToLocalChecked();
+    } else {
+        // 普通对象的 target，typeof 占位对象为 'object'，与普通对象的 exports 一致
+        target = v8::Object::New(isolate);
+    }
+    // 路径以字符串保存：写入快照之后路径表重新建立，路径 id 会变化，字符串不会
+    v8::Local<v8::Value> argv[] = {
+        target,
+        newString(isolate, paths_.path(pathId)),
+        parentPathId == kInvalidPathId ? v8::Undefined(isolate).As<v8::Value>() : newString(isolate, paths_.path(parentPathId)).As<v8::Value>()
+    };
+    v8::Local<v8::Object> stateObject = state(isolate, context);
+    v8::Local<v8::Function> factory = stateObject->Get(context, v8::String::NewFromUtf8Literal(isolate, "newStub")).ToLocalChecked().As<v8::Function>();
+    return handleScope.Escape(factory->Call(context, v8::Undefined(isolate), 3, argv).ToLocalChecked().As<v8::Object>());
+}
+
+void LazyModules::loadCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    LazyModules* lazyModules = from(isolate);
+    // 只在第一次访问和失效之后查找路径 id
+    uint32_t pathId = lazyModules->paths_.intern(*v8::String::Utf8Value(isolate, info[0]));
+    uint32_t parentPathId = info[1]->IsString() ? lazyModules->paths_.intern(*v8::String::Utf8Value(isolate, info[1])) : kInvalidPathId;
+    v8::TryCatch tryCatch(isolate);
+    v8::Local<v8::Value> exports;
+    if (!lazyModules->loader_(isolate, context, pathId, parentPathId).ToLocal(&exports)) {
+        // 模块执行抛出的异常原样抛给访问者，文件不存在等情况抛出新的异常
+        if (tryCatch.HasCaught()) {
+            tryCatch.ReThrow();
+        } else {
+            isolate->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8Literal(isolate, "惰性模块加载失败")));
+        }
+        return;
+    }
+    if (!exports->IsObject()) {
+        // 原始值无法通过 Proxy 转发
+        isolate->ThrowException(v8::Exception::TypeError(v8::String::NewFromUtf8Literal(isolate, "惰性模块的 exports 必须是对象")));
+        return;
+    }
+    info.GetReturnValue().Set(exports);
+}
+
+void LazyModules::targetCall(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    // apply 和 construct 陷阱总是转发给 exports，不会调用到 target 本身
+    info.GetIsolate()->ThrowException(v8::Exception::TypeError(v8::String::NewFromUtf8Literal(info.GetIsolate(), "惰性模块的占位对象不能直接调用")));
+}
@@ -0,0 +1,109 @@
+#ifndef COMMONJS_SERVER_LAZY_MODULE_H
+#define COMMONJS_SERVER_LAZY_MODULE_H
+
+#include <cstdint>
+#include <vector>
+#include "v8.h"
+#include "path_resolver.h"
+
+// isolate 数据槽中保存惰性模块的位置
+const uint32_t kLazyModulesSlot = 1;
+
+/**
+ * 惰性模块。require.lazy(path) 或者 --lazy 名单中的模块不会立即加载，
+ * 而是返回一个 Proxy 占位对象，第一次访问属性时才解析、编译并执行模块，
+ * 之后所有操作都直接转发给缓存在 handler 上的 exports。
+ * 陷阱是 JS 函数，每个上下文编译一次，只有第一次访问和热重载之后才进入原生代码加载模块。
+ * 默认的 target 是普通对象；声明为可调用的占位对象使用可调用的 API 对象作为 target，可以调用和 new。
+ */
+class LazyModules {
+public:
+    /**
+     * 加载模块的函数，返回模块的 exports，加载失败时返回空
+     */
+    typedef v8::MaybeLocal<v8::Value> (*Loader)(v8::Isolate* isolate, v8::Local<v8::Context> context,
+                                                uint32_t pathId, uint32_t parentPathId);
+
+    LazyModules(PathTable& paths, Loader loader) : paths_(paths), loader_(loader) {}
+
+    /**
+     * 把惰性模块挂到 isolate 上，陷阱函数通过 isolate 找到加载函数
+     * @param isolate
+     */
+    void attach(v8::Isolate* isolate);
+
+    static LazyModules* from(v8::Isolate* isolate);
+
+    /**
+     * 把模块加入惰性加载名单，名单中的模块 require 时也返回占位对象
+     * @param pathId 模块绝对路径 id
+     */
+    void add(uint32_t pathId);
+
+    bool isLazy(uint32_t pathId) const {
+        return pathId < lazy_.size() && lazy_[pathId];
+    }
+
+    /**
+     * 创建模块的占位对象
+     * @param isolate
+     * @param context
+     * @param pathId 模块绝对路径 id
+     * @param parentPathId 父模块绝对路径 id，加载时用于记录依赖
+     * @param callable exports 是否为函数。为 true 时占位对象可以调用和 new，typeof 为 'function'
+     * @return
+     */
+    v8::Local<v8::Object> newStub(v8::Isolate* isolate, v8::Local<v8::Context> context,
+                                  uint32_t pathId, uint32_t parentPathId, bool callable);
+
+    /**
+     * 让所有占位对象缓存的 exports 失效，下一次访问时重新加载。热重载驱逐模块之后调用
+     * @param isolate
+     * @param context
+     */
+    void invalidate(v8::Isolate* isolate, v8::Local<v8::Context> context);
+
+    /**
+     * 导出占位对象共享的状态对象，写入快照
+     * @param isolate
+     * @param context
+     * @return
+     */
+    v8::Local<v8::Object> exportState(v8::Isolate* isolate, v8::Local<v8::Context> context);
+
+    /**
+     * 从快照恢复共享的状态对象，快照中的占位对象与之后创建的占位对象一起失效
+     * @param isolate
+     * @param state
+     */
+    void importState(v8::Isolate* isolate, v8::Local<v8::Object> state);
+
+    /**
+     * 释放状态对象和模板。构建快照之前必须调用
+     */
+    void reset();
+
+    // 陷阱加载模块时调用的原生函数，需要登记到快照的 external references 中
+    static void loadCallback(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    // target 的调用处理函数，需要登记到快照的 external references 中
+    static void targetCall(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+private:
+    /**
+     * 共享的状态对象 { generation, newStub }，第一次使用时编译陷阱
+     * @param isolate
+     * @param context
+     * @return
+     */
+    v8::Local<v8::Object> state(v8::Isolate* isolate, v8::Local<v8::Context> context);
+
+    PathTable& paths_;
+    Loader loader_;
+    // 以路径 id 为下标的惰性加载名单
+    std::vector<bool> lazy_;
+    v8::Global<v8::Object> state_;
+    v8::Global<v8::ObjectTemplate> targetTemplate_;
+};
+
+#endif //COMMONJS_SERVER_LAZY_MODULE_H
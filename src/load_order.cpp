@@ -0,0 +1,40 @@
+#include "load_order.h"
+#include <fstream>
+
+void LoadOrder::record(uint32_t pathId) {
+    if (!recording_) {
+        return;
+    }
+    if (pathId >= recorded_.size()) {
+        recorded_.resize(pathId + 1, false);
+    }
+    if (recorded_[pathId]) {
+        return;
+    }
+    recorded_[pathId] = true;
+    order_.push_back(pathId);
+}
+
+bool LoadOrder::save(const std::string& file, const PathTable& paths) const {
+    std::ofstream out(file.c_str(), std::ios::trunc);
+    for (uint32_t pathId : order_) {
+        out << paths.path(pathId) << '\n';
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
+
+bool LoadOrder::load(const std::string& file, std::vector<std::string>& paths) {
+    std::ifstream in(file.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        // 只接受绝对路径，忽略空行
+        if (!line.empty() && line[0] == '/') {
+            paths.push_back(line);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef COMMONJS_SERVER_LOAD_ORDER_H
+#define COMMONJS_SERVER_LOAD_ORDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "path_resolver.h"
+
+/**
+ * 模块加载顺序记录。预热运行时记录 require/async 实际加载的模块绝对路径，
+ * 之后的启动读取这份列表，在主模块执行之前并行预取所有模块。
+ * 文件格式为每行一个绝对路径。
+ */
+class LoadOrder {
+public:
+    void setRecording(bool recording) { recording_ = recording; }
+    bool recording() const { return recording_; }
+
+    /**
+     * 记录一个模块，重复的模块只记录第一次
+     * @param pathId 模块绝对路径 id
+     */
+    void record(uint32_t pathId);
+
+    /**
+     * 写入记录文件
+     * @param file
+     * @param paths
+     * @return 是否成功
+     */
+    bool save(const std::string& file, const PathTable& paths) const;
+
+    /**
+     * 读取记录文件
+     * @param file
+     * @param paths 输出模块绝对路径
+     * @return 是否成功
+     */
+    static bool load(const std::string& file, std::vector<std::string>& paths);
+
+private:
+    bool recording_ = false;
+    std::vector<uint32_t> order_;
+    // 已经记录过的路径 id
+    std::vector<bool> recorded_;
+};
+
+#endif //COMMONJS_SERVER_LOAD_ORDER_H
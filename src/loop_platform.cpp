@@ -0,0 +1,51 @@
+#include "loop_platform.h"
+
+/**
+ * 转交给默认平台的前台任务队列，投递之后唤醒事件循环
+ */
+class LoopPlatform::LoopTaskRunner : public v8::TaskRunner {
+public:
+    LoopTaskRunner(std::shared_ptr<v8::TaskRunner> runner, EventLoop& loop) : runner_(std::move(runner)), loop_(loop) {}
+
+    void PostTask(std::unique_ptr<v8::Task> task) override {
+        runner_->PostTask(std::move(task));
+        loop_.wake();
+    }
+
+    void PostNonNestableTask(std::unique_ptr<v8::Task> task) override {
+        runner_->PostNonNestableTask(std::move(task));
+        loop_.wake();
+    }
+
+    void PostDelayedTask(std::unique_ptr<v8::Task> task, double delayInSeconds) override {
+        runner_->PostDelayedTask(std::move(task), delayInSeconds);
+        loop_.wakeAfter(static_cast<int64_t>(delayInSeconds * 1000));
+    }
+
+    void PostNonNestableDelayedTask(std::unique_ptr<v8::Task> task, double delayInSeconds) override {
+        runner_->PostNonNestableDelayedTask(std::move(task), delayInSeconds);
+        loop_.wakeAfter(static_cast<int64_t>(delayInSeconds * 1000));
+    }
+
+    // 空闲任务只在空闲时执行，不需要唤醒
+    void PostIdleTask(std::unique_ptr<v8::IdleTask> task) override { runner_->PostIdleTask(std::move(task)); }
+
+    bool IdleTasksEnabled() override { return runner_->IdleTasksEnabled(); }
+
+    bool NonNestableTasksEnabled() const override { return runner_->NonNestableTasksEnabled(); }
+
+    bool NonNestableDelayedTasksEnabled() const override { return runner_->NonNestableDelayedTasksEnabled(); }
+
+private:
+    std::shared_ptr<v8::TaskRunner> runner_;
+    EventLoop& loop_;
+};
+
+std::shared_ptr<v8::TaskRunner> LoopPlatform::GetForegroundTaskRunner(v8::Isolate* isolate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<LoopTaskRunner>& runner = runners_[isolate];
+    if (!runner) {
+        runner = std::make_shared<LoopTaskRunner>(platform_->GetForegroundTaskRunner(isolate), loop_);
+    }
+    return runner;
+}
@@ -0,0 +1,70 @@
+#ifndef COMMONJS_SERVER_LOOP_PLATFORM_H
+#define COMMONJS_SERVER_LOOP_PLATFORM_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "v8-platform.h"
+#include "event_loop.h"
+
+/**
+ * 包装默认平台，v8 向 isolate 投递前台任务时唤醒事件循环。
+ * wasm 异步编译、Atomics.waitAsync 等在后台线程完成之后通过前台任务交回结果，
+ * 事件循环阻塞在 epoll_wait 上看不到默认平台的任务队列，需要由投递方唤醒；延迟任务到期时唤醒。
+ * 其余接口全部转交给默认平台，PumpMessageLoop 仍然要对默认平台调用
+ */
+class LoopPlatform : public v8::Platform {
+public:
+    LoopPlatform(v8::Platform* platform, EventLoop& loop) : platform_(platform), loop_(loop) {}
+
+    v8::PageAllocator* GetPageAllocator() override { return platform_->GetPageAllocator(); }
+
+    void OnCriticalMemoryPressure() override { platform_->OnCriticalMemoryPressure(); }
+
+    bool OnCriticalMemoryPressure(size_t length) override { return platform_->OnCriticalMemoryPressure(length); }
+
+    int NumberOfWorkerThreads() override { return platform_->NumberOfWorkerThreads(); }
+
+    std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(v8::Isolate* isolate) override;
+
+    void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override { platform_->CallOnWorkerThread(std::move(task)); }
+
+    void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+        platform_->CallBlockingTaskOnWorkerThread(std::move(task));
+    }
+
+    void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+        platform_->CallLowPriorityTaskOnWorkerThread(std::move(task));
+    }
+
+    void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task, double delayInSeconds) override {
+        platform_->CallDelayedOnWorkerThread(std::move(task), delayInSeconds);
+    }
+
+    bool IdleTasksEnabled(v8::Isolate* isolate) override { return platform_->IdleTasksEnabled(isolate); }
+
+    std::unique_ptr<v8::JobHandle> PostJob(v8::TaskPriority priority, std::unique_ptr<v8::JobTask> jobTask) override {
+        return platform_->PostJob(priority, std::move(jobTask));
+    }
+
+    double MonotonicallyIncreasingTime() override { return platform_->MonotonicallyIncreasingTime(); }
+
+    double CurrentClockTimeMillis() override { return platform_->CurrentClockTimeMillis(); }
+
+    StackTracePrinter GetStackTracePrinter() override { return platform_->GetStackTracePrinter(); }
+
+    v8::TracingController* GetTracingController() override { return platform_->GetTracingController(); }
+
+    void DumpWithoutCrashing() override { platform_->DumpWithoutCrashing(); }
+
+private:
+    class LoopTaskRunner;
+
+    v8::Platform* platform_;
+    EventLoop& loop_;
+    // 后台线程也会取前台任务队列，受锁保护
+    std::mutex mutex_;
+    std::unordered_map<v8::Isolate*, std::shared_ptr<LoopTaskRunner>> runners_;
+};
+
+#endif //COMMONJS_SERVER_LOOP_PLATFORM_H
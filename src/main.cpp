@@ -1,85 +1,1123 @@
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include "v8.h"
 #include "libplatform/libplatform.h"
 #include <unistd.h>
-#include <algorithm>
-#include <sstream>
-#include <iterator>
 #include<fstream>
+#include <unordered_map>
+#include "async_require.h"
+#include "code_cache.h"
+#include "compile_hints.h"
+#include "dependency_graph.h"
+#include "es_module.h"
+#include "event_loop.h"
+#include "lazy_module.h"
+#include "load_order.h"
+#include "loop_platform.h"
+#include "module_archive.h"
+#include "mapped_file.h"
+#include "module_prefetcher.h"
+#include "module_registry.h"
+#include "module_trace.h"
+#include "module_watcher.h"
+#include "native_addon.h"
+#include "path_resolver.h"
+#include "require_scanner.h"
+#include "source_loader.h"
+#include "startup_analyzer.h"
+#include "wasm_module.h"
 
-// 当前模块的绝对路径
-v8::Persistent<v8::String> currentModuleId;
-// 模块缓存 key为模块的文件全路径，value 为 module对象
-v8::Persistent<v8::Object> cache;
+// 模块代码缓存
+CodeCache codeCache;
+// 模块路径驻留表和 require 路径解析缓存
+PathTable pathTable;
+PathResolver pathResolver(pathTable);
+// 模块缓存 key为模块的文件全路径 id，value 为 module对象
+ModuleRegistry moduleRegistry(pathTable);
+// 模块依赖图
+DependencyGraph dependencyGraph(moduleRegistry);
+// require.cache 只读视图
+v8::Persistent<v8::Object> requireCache;
+// 依赖预取
+ModulePrefetcher prefetcher(pathResolver, moduleRegistry, codeCache);
+// 事件循环
+EventLoop eventLoop;
+// 模块加载顺序记录
+LoadOrder loadOrder;
+// --watch 模式下监听已加载的模块文件
+ModuleWatcher moduleWatcher(pathResolver);
+// 预热编译提示
+CompileHints compileHints;
+// --trace-modules 模块加载追踪
+ModuleTrace moduleTrace;
+// require('x.node') 加载的原生模块
+NativeAddons nativeAddons;
+// require('x.wasm') 加载的 WebAssembly 模块
+WasmModules wasmModules(codeCache);
 
 /**
- * 技术路径path相对于 dir的绝对路径
- * @param path 文件路径
- * @param dir_name 目录
+ * 记录编译提示时保存的模块脚本，普通 CommonJS 模块保存的是模块函数
+ */
+struct RecordedScript {
+    uint32_t pathId;
+    SourceStamp stamp;
+    v8::Global<v8::UnboundScript> script;
+    v8::Global<v8::Function> function;
+};
+// 退出前为热模块重新生成代码缓存，缓存中包含预热期间执行过的函数
+std::vector<RecordedScript> recordedScripts;
+// --archive 指定的模块归档
+ModuleArchive moduleArchive;
+// 工作目录 id，主模块和 --lazy 名单相对于工作目录解析
+uint32_t workDirId = kInvalidPathId;
+// require 对象的模板，每个 isolate 只创建一次
+v8::Global<v8::FunctionTemplate> requireTemplate;
+
+// require 对象的内部字段。模块闭包持有 require 对象，构建快照时与 module 对象一样由 ModuleRegistry::serializeModuleId 序列化
+enum RequireField {
+    // 所属模块 id，主模块的 require 没有所属模块，字段为 undefined
+    kRequireOwnerField,
+    kRequireFieldCount
+};
+
+/**
+ * 设置工作目录，主模块相对于工作目录解析
+ * @param workDir
+ */
+void enterWorkDir(const char* workDir) {
+    workDirId = pathTable.intern(workDir);
+}
+
+/**
+ * 创建模块路径字符串
+ * @param isolate
+ * @param pathId
+ * @return
+ */
+v8::Local<v8::String> newPathString(v8::Isolate* isolate, uint32_t pathId) {
+    const std::string& path = pathTable.path(pathId);
+    return v8::String::NewFromUtf8(isolate, path.data(), v8::NewStringType::kNormal, static_cast<int>(path.size())).ToLocalChecked();
+}
+
+/**
+ * 编译好的模块。define 包装的模块编译成脚本；普通 CommonJS 模块编译成
+ * function (require, exports, module, __filename, __dirname) 形式的函数
+ */
+struct CompiledModule {
+    v8::Local<v8::Script> script;
+    v8::Local<v8::Function> function;
+    // 模块源码版本戳
+    SourceStamp stamp;
+    // 是否需要在首次执行之后写入代码缓存
+    bool produceCache = false;
+};
+
+/**
+ * 用 CompileFunctionInContext 把普通 CommonJS 模块编译成函数
+ * @param context
+ * @param source
+ * @param options
  * @return
  */
-std::string getAbsolutePath(const std::string& path,
-                            const std::string& dir) {
-    std::string absolute_path;
-    // 判断是否为绝对路径。在linux 上下。文件以 / 开头
-    if ( path[0] == '/') {
-        absolute_path = path;
+v8::MaybeLocal<v8::Function> compileFunctionModule(v8::Local<v8::Context> context, v8::ScriptCompiler::Source* source,
+                                                   v8::ScriptCompiler::CompileOptions options) {
+    v8::Isolate* isolate = context->GetIsolate();
+    v8::Local<v8::String> params[] = {
+        v8::String::NewFromUtf8Literal(isolate, "require"),
+        v8::String::NewFromUtf8Literal(isolate, "exports"),
+        v8::String::NewFromUtf8Literal(isolate, "module"),
+        v8::String::NewFromUtf8Literal(isolate, "__filename"),
+        v8::String::NewFromUtf8Literal(isolate, "__dirname")
+    };
+    return v8::ScriptCompiler::CompileFunctionInContext(context, source, 5, params, 0, nullptr, options);
+}
+
+/**
+ * 读取并编译模块。依次使用模块归档、后台预取的结果，最后才同步读取文件；
+ * 读取之后把源码中静态 require 的依赖交给后台预取。
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param compiled 输出编译后的模块
+ * @return 文件不存在或者编译失败时返回 false
+ */
+bool compileModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, CompiledModule& compiled) {
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    v8::Local<v8::String> resourceName = v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked();
+    v8::ScriptOrigin origin(isolate, resourceName);
+    v8::ScriptCompiler::CachedData* cachedData = nullptr;
+    v8::Local<v8::String> source;
+    SourceStamp& stamp = compiled.stamp;
+    bool defineModule = false;
+
+    // 读取阶段包含等待后台预取
+    TraceSpan readSpan(moduleTrace, "read", moduleAbsolutePath.c_str());
+    std::shared_ptr<PrefetchedModule> prefetched = prefetcher.take(isolate, modulePathId);
+    int archiveIndex = moduleArchive.find(moduleAbsolutePath);
+    if (archiveIndex >= 0) {
+        // 归档中的模块，源码和代码缓存都直接引用归档的映射，也不写文件缓存
+        const ArchiveEntry& entry = moduleArchive.entry(archiveIndex);
+        stamp.hash = entry.hash;
+        defineModule = isDefineModule(moduleArchive.source(archiveIndex), entry.sourceLength);
+        source = newSourceString(isolate, moduleArchive.source(archiveIndex), entry.sourceLength);
+        // 流式编译的结果是脚本，只能用于 define 包装的模块
+        if (prefetched && prefetched->streamed && defineModule && !source.IsEmpty()) {
+            codeCache.record(CodeCache::Lookup::kMiss);
+            readSpan.end();
+            TraceSpan compileSpan(moduleTrace, "compile", moduleAbsolutePath.c_str());
+            return v8::ScriptCompiler::Compile(context, prefetched->streamed.get(), source, origin).ToLocal(&compiled.script);
+        }
+        if (!prefetched) {
+            prefetcher.prefetchArchived(isolate, archiveIndex);
+        }
+        if (entry.cacheLength > 0 && moduleArchive.versionTag() == v8::ScriptCompiler::CachedDataVersionTag()) {
+            cachedData = new v8::ScriptCompiler::CachedData(moduleArchive.codeCache(archiveIndex), static_cast<int>(entry.cacheLength));
+        } else {
+            codeCache.record(entry.cacheLength > 0 ? CodeCache::Lookup::kRejected : CodeCache::Lookup::kMiss);
+        }
+    } else if (prefetched) {
+        if (!prefetched->file) {
+            return false;
+        }
+        stamp = prefetched->stamp;
+        defineModule = isDefineModule(prefetched->file->data(), prefetched->file->size());
+        source = newSourceString(isolate, std::move(prefetched->file));
+        if (prefetched->streamed && defineModule && !source.IsEmpty()) {
+            // 后台已经完成解析和编译
+            codeCache.record(CodeCache::Lookup::kMiss);
+            compiled.produceCache = true;
+            readSpan.end();
+            TraceSpan compileSpan(moduleTrace, "compile", moduleAbsolutePath.c_str());
+            return v8::ScriptCompiler::Compile(context, prefetched->streamed.get(), source, origin).ToLocal(&compiled.script);
+        }
+        codeCache.record(prefetched->lookup);
+        cachedData = prefetched->cachedData.release();
     } else {
-        absolute_path = dir + '/' + path;
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        if (!file->open(moduleAbsolutePath)) {
+            return false;
+        }
+        stamp.mtime = file->mtime();
+        stamp.hash = contentHash(file->data(), file->size());
+        defineModule = isDefineModule(file->data(), file->size());
+        prefetcher.scan(isolate, pathTable.dirname(modulePathId), file->data(), file->size());
+        source = newSourceString(isolate, std::move(file));
+        cachedData = codeCache.load(moduleAbsolutePath, stamp);
+    }
+    if (source.IsEmpty()) {
+        delete cachedData;
+        return false;
+    }
+    readSpan.end();
+
+    // 有可用的代码缓存时直接反序列化，跳过解析和编译
+    v8::ScriptCompiler::Source scriptSource(source, origin, cachedData);
+    // 没有代码缓存的热模块立即编译所有函数
+    v8::ScriptCompiler::CompileOptions compileOptions = v8::ScriptCompiler::kNoCompileOptions;
+    if (cachedData != nullptr) {
+        compileOptions = v8::ScriptCompiler::kConsumeCodeCache;
+    } else if (compileHints.isHot(modulePathId)) {
+        compileOptions = v8::ScriptCompiler::kEagerCompile;
     }
-    std::replace(absolute_path.begin(), absolute_path.end(), '\\', '/');
-    std::vector<std::string> segments;
-    std::istringstream segment_stream(absolute_path);
-    std::string segment;
-    while (std::getline(segment_stream, segment, '/')) {
-        if (segment == "..") {
-            segments.pop_back();
-        } else if (segment != ".") {
-            segments.push_back(segment);
+    TraceSpan compileSpan(moduleTrace, "compile", moduleAbsolutePath.c_str());
+    bool success = defineModule ?
+            v8::ScriptCompiler::Compile(context, &scriptSource, compileOptions).ToLocal(&compiled.script) :
+            compileFunctionModule(context, &scriptSource, compileOptions).ToLocal(&compiled.function);
+    bool cacheAccepted = codeCache.report(scriptSource.GetCachedData());
+    compiled.produceCache = archiveIndex < 0 && !cacheAccepted;
+    return success;
+}
+
+/**
+ * 创建模块的 require 对象。require 对象由 require 模板实例化，可以像函数一样调用，
+ * 带有 async、resolve、lazy、graph、cache 属性
+ * @param isolate
+ * @param context
+ * @param moduleId 所属模块 id，主模块为 kInvalidModuleId
+ * @return
+ */
+v8::Local<v8::Object> newRequireFunction(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t moduleId);
+
+/**
+ * 执行普通 CommonJS 模块。先注册 module 对象再执行，循环依赖时可以拿到未完成的 exports
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param function 模块函数
+ * @return 模块抛出异常时返回 false
+ */
+bool runFunctionModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, v8::Local<v8::Function> function) {
+    v8::Local<v8::Object> exports = v8::Object::New(isolate);
+    uint32_t moduleIndex;
+    v8::Local<v8::Object> module = moduleRegistry.create(isolate, context, modulePathId, exports, moduleIndex);
+
+    v8::Local<v8::Value> argv[] = {
+        newRequireFunction(isolate, context, moduleIndex),
+        exports,
+        module,
+        newPathString(isolate, modulePathId),
+        newPathString(isolate, pathTable.dirname(modulePathId))
+    };
+    // 与 node 一致，模块顶层的 this 为 module.exports
+    return !function->Call(context, exports, 5, argv).IsEmpty();
+}
+
+/**
+ * 记录模块从 start 到现在的加载区间，加载耗时包含依赖的加载
+ * @param moduleId
+ * @param start
+ */
+void recordLoadTime(uint32_t moduleId, std::chrono::steady_clock::time_point start) {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    dependencyGraph.setLoadSpan(moduleId, std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(),
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count());
+}
+
+/**
+ * 是否按 ES 模块加载。扩展名为 .mjs 的文件是 ES 模块
+ * @param path
+ * @return
+ */
+bool isEsModulePath(const std::string& path) {
+    return path.size() > 4 && path.compare(path.size() - 4, 4, ".mjs") == 0;
+}
+
+/**
+ * 加载并求值 ES 模块，或者包装成合成模块的 CommonJS 模块
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @param evaluation 输出求值结果，可以为 nullptr。模块使用顶层 await 时为尚未完成的 Promise
+ * @return 模块命名空间，失败时抛出异常并返回空
+ */
+v8::MaybeLocal<v8::Value> importModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId,
+                                      uint32_t parentPathId, v8::Local<v8::Value>* evaluation);
+
+// 不小于该大小的 JSON 模块在首次加载之后把解析结果序列化到缓存文件，反序列化比重新解析快；小文件直接解析
+const size_t kJsonCacheThreshold = 64 * 1024;
+
+/**
+ * 是否按 JSON 加载。扩展名为 .json 的文件不经过编译器，直接用 JSON::Parse 解析
+ * @param path
+ * @return
+ */
+bool isJsonPath(const std::string& path) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+}
+
+/**
+ * 把 JSON 模块的解析结果用 ValueSerializer 序列化，结果与代码缓存存放在同一个缓存文件中
+ * @param isolate
+ * @param context
+ * @param value
+ * @return 调用方负责释放，无法序列化时返回 nullptr
+ */
+v8::ScriptCompiler::CachedData* serializeJson(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Value> value) {
+    v8::ValueSerializer serializer(isolate);
+    serializer.WriteHeader();
+    if (!serializer.WriteValue(context, value).FromMaybe(false)) {
+        return nullptr;
+    }
+    // ValueSerializer 的缓冲区由 realloc 分配，而 CachedData 用 delete[] 释放，需要拷贝一次
+    std::pair<uint8_t*, size_t> buffer = serializer.Release();
+    uint8_t* data = new uint8_t[buffer.second];
+    memcpy(data, buffer.first, buffer.second);
+    free(buffer.first);
+    return new v8::ScriptCompiler::CachedData(data, static_cast<int>(buffer.second), v8::ScriptCompiler::CachedData::BufferOwned);
+}
+
+/**
+ * 反序列化 JSON 模块的缓存
+ * @param isolate
+ * @param context
+ * @param data
+ * @return 缓存格式不兼容时返回空
+ */
+v8::MaybeLocal<v8::Value> deserializeJson(v8::Isolate* isolate, v8::Local<v8::Context> context, const v8::ScriptCompiler::CachedData* data) {
+    v8::TryCatch tryCatch(isolate);
+    v8::ValueDeserializer deserializer(isolate, data->data, static_cast<size_t>(data->length));
+    if (!deserializer.ReadHeader(context).FromMaybe(false)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    return deserializer.ReadValue(context);
+}
+
+/**
+ * 加载 JSON 模块，exports 为解析结果。源码的来源与 compileModule 相同；
+ * 有序列化缓存时直接反序列化，否则调用 JSON::Parse，完全不经过编译器
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @return 文件不存在时返回空，JSON 格式错误时抛出 SyntaxError 并返回空
+ */
+v8::MaybeLocal<v8::Value> loadJsonModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    SourceStamp stamp;
+    std::unique_ptr<v8::ScriptCompiler::CachedData> cachedData;
+    v8::Local<v8::String> source;
+    size_t length = 0;
+
+    std::shared_ptr<PrefetchedModule> prefetched = prefetcher.take(isolate, modulePathId);
+    int archiveIndex = moduleArchive.find(moduleAbsolutePath);
+    if (archiveIndex >= 0) {
+        const ArchiveEntry& entry = moduleArchive.entry(archiveIndex);
+        stamp.hash = entry.hash;
+        length = entry.sourceLength;
+        source = newSourceString(isolate, moduleArchive.source(archiveIndex), entry.sourceLength);
+        if (entry.cacheLength > 0 && moduleArchive.versionTag() == v8::ScriptCompiler::CachedDataVersionTag()) {
+            cachedData.reset(new v8::ScriptCompiler::CachedData(moduleArchive.codeCache(archiveIndex), static_cast<int>(entry.cacheLength)));
+        } else {
+            codeCache.record(entry.cacheLength > 0 ? CodeCache::Lookup::kRejected : CodeCache::Lookup::kMiss);
+        }
+    } else if (prefetched) {
+        if (!prefetched->file) {
+            return v8::MaybeLocal<v8::Value>();
         }
+        stamp = prefetched->stamp;
+        length = prefetched->file->size();
+        source = newSourceString(isolate, std::move(prefetched->file));
+        codeCache.record(prefetched->lookup);
+        cachedData = std::move(prefetched->cachedData);
+    } else {
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        if (!file->open(moduleAbsolutePath)) {
+            return v8::MaybeLocal<v8::Value>();
+        }
+        stamp.mtime = file->mtime();
+        stamp.hash = contentHash(file->data(), file->size());
+        length = file->size();
+        source = newSourceString(isolate, std::move(file));
+        cachedData.reset(codeCache.load(moduleAbsolutePath, stamp));
+    }
+    if (source.IsEmpty()) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+
+    TraceSpan parseSpan(moduleTrace, "parse", moduleAbsolutePath.c_str());
+    v8::Local<v8::Value> value;
+    bool cacheAccepted = false;
+    if (cachedData) {
+        cacheAccepted = deserializeJson(isolate, context, cachedData.get()).ToLocal(&value);
+        cachedData->rejected = !cacheAccepted;
+        codeCache.report(cachedData.get());
+    }
+    if (!cacheAccepted) {
+        std::string message;
+        {
+            v8::TryCatch tryCatch(isolate);
+            if (!v8::JSON::Parse(context, source).ToLocal(&value)) {
+                message = moduleAbsolutePath + ": " + *v8::String::Utf8Value(isolate, tryCatch.Exception());
+            }
+        }
+        if (value.IsEmpty()) {
+            // 与 node 一致，错误信息带上文件路径
+            isolate->ThrowException(v8::Exception::SyntaxError(v8::String::NewFromUtf8(isolate, message.data(), v8::NewStringType::kNormal,
+                                                                                        static_cast<int>(message.size())).ToLocalChecked()));
+            return v8::MaybeLocal<v8::Value>();
+        }
+        if (archiveIndex < 0 && length >= kJsonCacheThreshold && codeCache.enabled()) {
+            std::unique_ptr<v8::ScriptCompiler::CachedData> data(serializeJson(isolate, context, value));
+            codeCache.save(moduleAbsolutePath, stamp, data.get());
+        }
+    }
+    loadOrder.record(modulePathId);
+    if (moduleWatcher.started() && archiveIndex < 0) {
+        moduleWatcher.watch(modulePathId);
     }
-    std::ostringstream os;
-    std::copy(segments.begin(), segments.end() - 1,
-              std::ostream_iterator<std::string>(os, "/"));
-    os << *segments.rbegin();
-    return os.str();
+
+    uint32_t moduleId;
+    moduleRegistry.create(isolate, context, modulePathId, value, moduleId);
+    recordLoadTime(moduleId, start);
+    uint32_t parentModuleId = moduleRegistry.find(parentPathId);
+    if (parentModuleId != kInvalidModuleId) {
+        dependencyGraph.addEdge(parentModuleId, moduleId);
+    }
+    return value;
 }
 
 /**
- * 读取文件
+ * 是否按原生模块加载。扩展名为 .node 的文件是共享库
  * @param path
  * @return
  */
-v8::Local<v8::String>  readFile (std::string& path) {
-    v8::Isolate* isolate = v8::Isolate::GetCurrent();
-    // 读取主模块文件
-    std::ifstream in(path.c_str());
-    // 如果打开文件失败
-    if (!in.is_open()) {
-        return v8::Local<v8::String>();
-    }
-    std::string source;
-    char buffer[256];
-    // 如果没有读取到文件结束符位置。
-    while(!in.eof()){
-        in.getline(buffer,256);
-        source.append(buffer);
-    };
-    return v8::String::NewFromUtf8(isolate, source.c_str()).ToLocalChecked();
+bool isNativeAddonPath(const std::string& path) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".node") == 0;
+}
+
+/**
+ * 加载原生模块，exports 由共享库的注册函数填充。共享库不能热重载，也不写入模块归档，不需要监听和记录加载顺序
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @return 失败时抛出异常并返回空
+ */
+v8::MaybeLocal<v8::Value> loadNativeModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    v8::Local<v8::Object> exports;
+    if (!nativeAddons.load(isolate, context, pathTable.path(modulePathId)).ToLocal(&exports)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    uint32_t moduleId;
+    moduleRegistry.create(isolate, context, modulePathId, exports, moduleId);
+    recordLoadTime(moduleId, start);
+    uint32_t parentModuleId = moduleRegistry.find(parentPathId);
+    if (parentModuleId != kInvalidModuleId) {
+        dependencyGraph.addEdge(parentModuleId, moduleId);
+    }
+    return exports;
+}
+
+/**
+ * 抛出找不到模块的异常
+ * @param isolate
+ * @param modulePathId
+ */
+void throwModuleNotFound(v8::Isolate* isolate, uint32_t modulePathId) {
+    std::string message = "找不到模块: " + pathTable.path(modulePathId);
+    isolate->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8(isolate, message.data(), v8::NewStringType::kNormal,
+                                                                         static_cast<int>(message.size())).ToLocalChecked()));
+}
+
+/**
+ * 是否按 WebAssembly 模块加载。扩展名为 .wasm 的文件是 wasm 二进制
+ * @param path
+ * @return
+ */
+bool isWasmPath(const std::string& path) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".wasm") == 0;
+}
+
+v8::MaybeLocal<v8::Value> loadModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId);
+
+uint32_t resolveRequire(v8::Isolate* isolate, uint32_t parentPathId, v8::Local<v8::Value> specifier);
+
+/**
+ * 加载 WebAssembly 模块，exports 为实例的 exports。wasm 字节的来源与 compileModule 相同，同步编译，require.async 流式编译时的结果缓存在模块的缓存文件中。
+ * wasm 的每个导入模块名按 require 的规则相对于 wasm 文件解析，加载之后的 exports 作为对应的导入对象
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @return 文件不存在时返回空，编译、导入或者实例化失败时抛出异常并返回空
+ */
+v8::MaybeLocal<v8::Value> loadWasmModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    SourceStamp stamp;
+    std::unique_ptr<MappedFile> file;
+    const char* bytes = nullptr;
+    size_t length = 0;
+
+    std::shared_ptr<PrefetchedModule> prefetched = prefetcher.take(isolate, modulePathId);
+    int archiveIndex = moduleArchive.find(moduleAbsolutePath);
+    if (archiveIndex >= 0) {
+        const ArchiveEntry& entry = moduleArchive.entry(archiveIndex);
+        stamp.hash = entry.hash;
+        bytes = moduleArchive.source(archiveIndex);
+        length = entry.sourceLength;
+    } else if (prefetched) {
+        if (!prefetched->file) {
+            return v8::MaybeLocal<v8::Value>();
+        }
+        stamp = prefetched->stamp;
+        file = std::move(prefetched->file);
+    } else {
+        file.reset(new MappedFile());
+        if (!file->open(moduleAbsolutePath)) {
+            return v8::MaybeLocal<v8::Value>();
+        }
+        stamp.mtime = file->mtime();
+        stamp.hash = contentHash(file->data(), file->size());
+    }
+    if (file) {
+        bytes = file->data();
+        length = file->size();
+    }
+    // 映射的字节在编译结束之前一直有效
+    TraceSpan compileSpan(moduleTrace, "compile", moduleAbsolutePath.c_str());
+    v8::Local<v8::WasmModuleObject> module;
+    if (!wasmModules.compile(isolate, context, moduleAbsolutePath, reinterpret_cast<const uint8_t*>(bytes), length,
+                             stamp).ToLocal(&module)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    compileSpan.end();
+    file.reset();
+    loadOrder.record(modulePathId);
+    if (moduleWatcher.started() && archiveIndex < 0) {
+        moduleWatcher.watch(modulePathId);
+    }
+
+    // WebAssembly.Module.imports(module) 列出 { module, name, kind }，同一个导入模块只加载一次
+    v8::Local<v8::Object> webAssembly = context->Global()->Get(context, v8::String::NewFromUtf8Literal(isolate, "WebAssembly")).ToLocalChecked().As<v8::Object>();
+    v8::Local<v8::Function> moduleConstructor = webAssembly->Get(context, v8::String::NewFromUtf8Literal(isolate, "Module")).ToLocalChecked().As<v8::Function>();
+    v8::Local<v8::Function> importsFunction = moduleConstructor->Get(context, v8::String::NewFromUtf8Literal(isolate, "imports")).ToLocalChecked().As<v8::Function>();
+    v8::Local<v8::Value> importsArgv[] = { module };
+    v8::Local<v8::Value> imports;
+    if (!importsFunction->Call(context, moduleConstructor, 1, importsArgv).ToLocal(&imports)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    v8::Local<v8::String> moduleKey = v8::String::NewFromUtf8Literal(isolate, "module");
+    v8::Local<v8::Object> importObject = v8::Object::New(isolate);
+    std::vector<uint32_t> importPathIds;
+    v8::Local<v8::Array> descriptors = imports.As<v8::Array>();
+    for (uint32_t index = 0; index < descriptors->Length(); ++index) {
+        v8::Local<v8::Value> descriptor = descriptors->Get(context, index).ToLocalChecked();
+        v8::Local<v8::Value> specifier = descriptor.As<v8::Object>()->Get(context, moduleKey).ToLocalChecked();
+        if (importObject->HasOwnProperty(context, specifier.As<v8::Name>()).FromJust()) {
+            continue;
+        }
+        uint32_t importPathId = resolveRequire(isolate, modulePathId, specifier);
+        v8::Local<v8::Value> importExports;
+        {
+            v8::TryCatch tryCatch(isolate);
+            if (!loadModule(isolate, context, importPathId, kInvalidPathId).ToLocal(&importExports)) {
+                if (tryCatch.HasCaught()) {
+                    tryCatch.ReThrow();
+                } else {
+                    throwModuleNotFound(isolate, importPathId);
+                }
+                return v8::MaybeLocal<v8::Value>();
+            }
+        }
+        importObject->Set(context, specifier, importExports).FromJust();
+        importPathIds.push_back(importPathId);
+    }
+
+    v8::Local<v8::Function> instanceConstructor = webAssembly->Get(context, v8::String::NewFromUtf8Literal(isolate, "Instance")).ToLocalChecked().As<v8::Function>();
+    v8::Local<v8::Value> instanceArgv[] = { module, importObject };
+    v8::Local<v8::Object> instance;
+    v8::Local<v8::Value> exports;
+    if (!instanceConstructor->NewInstance(context, 2, instanceArgv).ToLocal(&instance) ||
+        !instance->Get(context, v8::String::NewFromUtf8Literal(isolate, "exports")).ToLocal(&exports)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+
+    uint32_t moduleId;
+    moduleRegistry.create(isolate, context, modulePathId, exports, moduleId);
+    for (uint32_t importPathId : importPathIds) {
+        uint32_t importModuleId = moduleRegistry.find(importPathId);
+        if (importModuleId != kInvalidModuleId) {
+            dependencyGraph.addEdge(moduleId, importModuleId);
+        }
+    }
+    recordLoadTime(moduleId, start);
+    uint32_t parentModuleId = moduleRegistry.find(parentPathId);
+    if (parentModuleId != kInvalidModuleId) {
+        dependencyGraph.addEdge(parentModuleId, moduleId);
+    }
+    return exports;
+}
+
+/**
+ * 加载模块并返回 exports。已经加载过的模块直接返回缓存的 exports，
+ * 否则编译执行模块，并把模块记录到父模块的依赖中。
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @return 文件不存在、编译失败、模块抛出异常或者 exports 为 undefined 时返回空
+ */
+v8::MaybeLocal<v8::Value> loadModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId) {
+    v8::EscapableHandleScope handleScope(isolate);
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    uint32_t parentModuleId = moduleRegistry.find(parentPathId);
+
+    // 查找缓存
+    uint32_t moduleId = moduleRegistry.find(modulePathId);
+    // 如果命中缓存，直接使用缓存的 exports
+    if (moduleId != kInvalidModuleId) {
+        if (parentModuleId != kInvalidModuleId) {
+            dependencyGraph.addEdge(parentModuleId, moduleId);
+        }
+        return handleScope.EscapeMaybe(moduleRegistry.exports(isolate, context, moduleId));
+    }
+    // 依赖的加载嵌套在这个事件之内
+    TraceSpan loadSpan(moduleTrace, "load", moduleAbsolutePath.c_str());
+    // ES 模块的 exports 为模块命名空间
+    if (isEsModulePath(moduleAbsolutePath)) {
+        return handleScope.EscapeMaybe(importModule(isolate, context, modulePathId, parentPathId, nullptr));
+    }
+    if (isJsonPath(moduleAbsolutePath)) {
+        return handleScope.EscapeMaybe(loadJsonModule(isolate, context, modulePathId, parentPathId));
+    }
+    if (isNativeAddonPath(moduleAbsolutePath)) {
+        return handleScope.EscapeMaybe(loadNativeModule(isolate, context, modulePathId, parentPathId));
+    }
+    if (isWasmPath(moduleAbsolutePath)) {
+        return handleScope.EscapeMaybe(loadWasmModule(isolate, context, modulePathId, parentPathId));
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // 读取原文件并构建脚本
+    CompiledModule compiled;
+    if (!compileModule(isolate, context, modulePathId, compiled)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    loadOrder.record(modulePathId);
+    // 归档中的模块不对应磁盘文件，不需要监听，也不写文件缓存
+    bool onDisk = moduleArchive.find(moduleAbsolutePath) < 0;
+    if (moduleWatcher.started() && onDisk) {
+        moduleWatcher.watch(modulePathId);
+    }
+
+    // 执行模块。模块执行期间调用的 define 注册到该模块，嵌套加载结束之后自动回到父模块
+    TraceSpan executeSpan(moduleTrace, "execute", moduleAbsolutePath.c_str());
+    moduleRegistry.pushLoading(modulePathId);
+    bool success = !compiled.function.IsEmpty() ?
+            runFunctionModule(isolate, context, modulePathId, compiled.function) :
+            !compiled.script->Run(context).IsEmpty();
+    moduleRegistry.popLoading();
+    executeSpan.end();
+    if (!success) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    // 代码缓存、编译提示、依赖图
+    TraceSpan bookkeepingSpan(moduleTrace, "bookkeeping", moduleAbsolutePath.c_str());
+    // 缓存未命中或者被拒绝时，在首次执行之后生成缓存，这样执行过程中惰性编译的函数也会包含在缓存里
+    if (compiled.produceCache) {
+        if (!compiled.function.IsEmpty()) {
+            codeCache.save(moduleAbsolutePath, compiled.stamp, compiled.function);
+        } else {
+            codeCache.save(moduleAbsolutePath, compiled.stamp, compiled.script->GetUnboundScript());
+        }
+    }
+    if (compileHints.recording() && onDisk) {
+        RecordedScript recorded;
+        recorded.pathId = modulePathId;
+        recorded.stamp = compiled.stamp;
+        if (!compiled.function.IsEmpty()) {
+            recorded.function.Reset(isolate, compiled.function);
+        } else {
+            recorded.script.Reset(isolate, compiled.script->GetUnboundScript());
+        }
+        recordedScripts.push_back(std::move(recorded));
+    }
+    // 从缓存模块中获取
+    moduleId = moduleRegistry.find(modulePathId);
+    if (moduleId == kInvalidModuleId) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    // 加载耗时包含依赖的加载
+    recordLoadTime(moduleId, start);
+    v8::Local<v8::Value> exports;
+    if (!moduleRegistry.exports(isolate, context, moduleId).ToLocal(&exports) || exports->IsUndefined()) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    // 把当前模块设置到父模块的依赖项中，重复的边由依赖图去重
+    if (parentModuleId != kInvalidModuleId) {
+        dependencyGraph.addEdge(parentModuleId, moduleId);
+    }
+    return handleScope.Escape(exports);
+}
+
+// 惰性加载的模块
+LazyModules lazyModules(pathTable, loadModule);
+/**
+ * require.async 的模块读取完成之后的准备。还没有加载的 wasm 模块在事件循环中流式编译，可以使用磁盘上的编译缓存；
+ * 之后执行模块时同步的 require 直接取用编译结果
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param done 编译结束时调用
+ * @param data
+ * @return 是否开始了编译
+ */
+bool prepareAsyncModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId,
+                        CompletionQueue::Callback done, void* data) {
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    // 归档中的模块不读写编译缓存，同步编译即可
+    if (!isWasmPath(moduleAbsolutePath) || moduleRegistry.find(modulePathId) != kInvalidModuleId ||
+        moduleArchive.find(moduleAbsolutePath) >= 0) {
+        return false;
+    }
+    std::shared_ptr<PrefetchedModule> prefetched = prefetcher.take(isolate, modulePathId);
+    if (!prefetched || !prefetched->file) {
+        return false;
+    }
+    return wasmModules.compileAsync(isolate, context, moduleAbsolutePath, std::move(prefetched->file), prefetched->stamp, done, data);
+}
+
+// require.async 的请求
+AsyncRequires asyncRequires(pathTable, prefetcher, eventLoop, loadModule, prepareAsyncModule);
+
+/**
+ * 创建惰性模块的占位对象。模块已经加载时直接返回 exports
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @param parentPathId 父模块绝对路径 id
+ * @param callable 模块的 exports 是否为函数
+ * @return
+ */
+v8::Local<v8::Value> lazyExports(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId, uint32_t parentPathId,
+                                 bool callable) {
+    uint32_t moduleId = moduleRegistry.find(modulePathId);
+    if (moduleId != kInvalidModuleId) {
+        return moduleRegistry.exports(isolate, context, moduleId).ToLocalChecked();
+    }
+    return lazyModules.newStub(isolate, context, modulePathId, parentPathId, callable);
+}
+
+/**
+ * 找到 require 对象所属的模块。require 对象的内部字段保存所属模块 id，
+ * 不是 require 对象(例如把 require.async 单独取出来调用)时按主模块处理
+ * @param isolate
+ * @param holder require 对象
+ * @return 所属模块的绝对路径 id，主模块返回 kInvalidPathId
+ */
+uint32_t requireOwner(v8::Isolate* isolate, v8::Local<v8::Object> holder) {
+    if (!requireTemplate.Get(isolate)->HasInstance(holder)) {
+        return kInvalidPathId;
+    }
+    v8::Local<v8::Value> owner = holder->GetInternalField(kRequireOwnerField);
+    return owner->IsUint32() ? moduleRegistry.pathId(owner.As<v8::Uint32>()->Value()) : kInvalidPathId;
+}
+
+/**
+ * 解析 require 的路径，相对于父模块所在目录，主模块相对于工作目录。重复的 require 直接命中解析缓存
+ * @param isolate
+ * @param parentPathId 父模块绝对路径 id
+ * @param specifier
+ * @return
+ */
+uint32_t resolveRequire(v8::Isolate* isolate, uint32_t parentPathId, v8::Local<v8::Value> specifier) {
+    uint32_t baseDirId = parentPathId != kInvalidPathId ? pathTable.dirname(parentPathId) : workDirId;
+    v8::String::Utf8Value specifierValue(isolate, specifier);
+    TraceSpan resolveSpan(moduleTrace, "resolve", *specifierValue);
+    return pathResolver.resolve(baseDirId, *specifierValue);
+}
+
+/**
+ * 以 parentPathId 为父模块 require 模块
+ * @param isolate
+ * @param context
+ * @param parentPathId 父模块绝对路径 id，主模块为 kInvalidPathId
+ * @param specifier
+ * @return
+ */
+v8::MaybeLocal<v8::Value> requireModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t parentPathId, v8::Local<v8::Value> specifier) {
+    uint32_t modulePathId = resolveRequire(isolate, parentPathId, specifier);
+    // --lazy 名单中的模块返回普通对象的占位对象
+    if (lazyModules.isLazy(modulePathId)) {
+        return lazyExports(isolate, context, modulePathId, parentPathId, false);
+    }
+    return loadModule(isolate, context, modulePathId, parentPathId);
+}
+
+/**
+ * 编译之后等待注册的 ES 模块
+ */
+struct PendingEsModule {
+    uint32_t pathId;
+    SourceStamp stamp;
+    // 是否需要在求值之后写入代码缓存
+    bool produceCache;
+};
+// ES 模块表
+EsModuleMap esModules;
+// 已经编译、还没有注册到模块注册表的 ES 模块
+std::vector<PendingEsModule> pendingEsModules;
+// 实例化时解析到的静态 import (父模块路径 id, 子模块路径 id)，模块注册之后转换成依赖图的边
+std::vector<std::pair<uint32_t, uint32_t>> pendingEsEdges;
+
+/**
+ * 读取并编译 ES 模块，源码和代码缓存的来源与 compileModule 相同。
+ * 编译之后模块的静态 import 全部已知，立即在后台预取，实例化时整张依赖图已经在并行读取。
+ * @param isolate
+ * @param context
+ * @param modulePathId 模块绝对路径 id
+ * @return 文件不存在或者编译失败时抛出异常并返回空
+ */
+v8::MaybeLocal<v8::Module> compileEsModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId) {
+    const std::string& moduleAbsolutePath = pathTable.path(modulePathId);
+    PendingEsModule pending;
+    pending.pathId = modulePathId;
+    v8::ScriptCompiler::CachedData* cachedData = nullptr;
+    v8::Local<v8::String> source;
+
+    TraceSpan readSpan(moduleTrace, "read", moduleAbsolutePath.c_str());
+    std::shared_ptr<PrefetchedModule> prefetched = prefetcher.take(isolate, modulePathId);
+    int archiveIndex = moduleArchive.find(moduleAbsolutePath);
+    if (archiveIndex >= 0) {
+        const ArchiveEntry& entry = moduleArchive.entry(archiveIndex);
+        pending.stamp.hash = entry.hash;
+        source = newSourceString(isolate, moduleArchive.source(archiveIndex), entry.sourceLength);
+        if (entry.cacheLength > 0 && moduleArchive.versionTag() == v8::ScriptCompiler::CachedDataVersionTag()) {
+            cachedData = new v8::ScriptCompiler::CachedData(moduleArchive.codeCache(archiveIndex), static_cast<int>(entry.cacheLength));
+        } else {
+            codeCache.record(entry.cacheLength > 0 ? CodeCache::Lookup::kRejected : CodeCache::Lookup::kMiss);
+        }
+    } else if (prefetched && prefetched->file) {
+        pending.stamp = prefetched->stamp;
+        source = newSourceString(isolate, std::move(prefetched->file));
+        codeCache.record(prefetched->lookup);
+        cachedData = prefetched->cachedData.release();
+    } else {
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        if (!prefetched && file->open(moduleAbsolutePath)) {
+            pending.stamp.mtime = file->mtime();
+            pending.stamp.hash = contentHash(file->data(), file->size());
+            source = newSourceString(isolate, std::move(file));
+            cachedData = codeCache.load(moduleAbsolutePath, pending.stamp);
+        }
+    }
+    if (source.IsEmpty()) {
+        delete cachedData;
+        throwModuleNotFound(isolate, modulePathId);
+        return v8::MaybeLocal<v8::Module>();
+    }
+    readSpan.end();
+
+    TraceSpan compileSpan(moduleTrace, "compile", moduleAbsolutePath.c_str());
+    v8::ScriptOrigin origin(isolate, newPathString(isolate, modulePathId), 0, 0, false, -1, v8::Local<v8::Value>(), false, false, true);
+    v8::ScriptCompiler::Source moduleSource(source, origin, cachedData);
+    v8::ScriptCompiler::CompileOptions compileOptions = v8::ScriptCompiler::kNoCompileOptions;
+    if (cachedData != nullptr) {
+        compileOptions = v8::ScriptCompiler::kConsumeCodeCache;
+    } else if (compileHints.isHot(modulePathId)) {
+        compileOptions = v8::ScriptCompiler::kEagerCompile;
+    }
+    v8::Local<v8::Module> module;
+    if (!v8::ScriptCompiler::CompileModule(isolate, &moduleSource, compileOptions).ToLocal(&module)) {
+        return v8::MaybeLocal<v8::Module>();
+    }
+    compileSpan.end();
+    pending.produceCache = archiveIndex < 0 && !codeCache.report(moduleSource.GetCachedData());
+    pendingEsModules.push_back(pending);
+    loadOrder.record(modulePathId);
+    if (moduleWatcher.started() && archiveIndex < 0) {
+        moduleWatcher.watch(modulePathId);
+    }
+
+    v8::Local<v8::FixedArray> requests = module->GetModuleRequests();
+    for (int index = 0; index < requests->Length(); ++index) {
+        v8::Local<v8::ModuleRequest> request = requests->Get(context, index).As<v8::ModuleRequest>();
+        prefetcher.prefetch(isolate, resolveRequire(isolate, modulePathId, request->GetSpecifier()));
+    }
+    return module;
+}
+
+/**
+ * 合成模块的求值步骤：加载被 import 的 CommonJS 模块，exports 作为 default 导出
+ * @param context
+ * @param module
+ * @return
+ */
+v8::MaybeLocal<v8::Value> evaluateCommonJsModule(v8::Local<v8::Context> context, v8::Local<v8::Module> module) {
+    v8::Isolate* isolate = context->GetIsolate();
+    uint32_t modulePathId = esModules.pathId(isolate, module);
+    v8::Local<v8::Value> exports;
+    {
+        v8::TryCatch tryCatch(isolate);
+        if (!loadModule(isolate, context, modulePathId, kInvalidPathId).ToLocal(&exports)) {
+            if (tryCatch.HasCaught()) {
+                tryCatch.ReThrow();
+            } else {
+                throwModuleNotFound(isolate, modulePathId);
+            }
+            return v8::MaybeLocal<v8::Value>();
+        }
+    }
+    if (module->SetSyntheticModuleExport(isolate, v8::String::NewFromUtf8Literal(isolate, "default"), exports).IsNothing()) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    // 开启顶层 await 之后模块的求值结果是 Promise
+    v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+    resolver->Resolve(context, v8::Undefined(isolate)).FromJust();
+    return resolver->GetPromise();
+}
+
+/**
+ * 取得路径对应的模块，没有时编译。.mjs 编译成 ES 模块，其他文件包装成合成模块，求值时按 CommonJS 加载
+ * @param isolate
+ * @param context
+ * @param modulePathId
+ * @return
+ */
+v8::MaybeLocal<v8::Module> getEsModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId) {
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::Module> module;
+    if (esModules.find(isolate, modulePathId).ToLocal(&module)) {
+        return handleScope.Escape(module);
+    }
+    if (isEsModulePath(pathTable.path(modulePathId))) {
+        if (!compileEsModule(isolate, context, modulePathId).ToLocal(&module)) {
+            return v8::MaybeLocal<v8::Module>();
+        }
+    } else {
+        std::vector<v8::Local<v8::String>> exportNames = { v8::String::NewFromUtf8Literal(isolate, "default") };
+        module = v8::Module::CreateSyntheticModule(isolate, newPathString(isolate, modulePathId), exportNames, evaluateCommonJsModule);
+    }
+    esModules.add(isolate, modulePathId, module);
+    return handleScope.Escape(module);
+}
+
+/**
+ * 实例化时解析静态 import，与 require 共用路径解析缓存
+ * @param context
+ * @param specifier
+ * @param importAssertions
+ * @param referrer
+ * @return
+ */
+v8::MaybeLocal<v8::Module> resolveEsModule(v8::Local<v8::Context> context, v8::Local<v8::String> specifier,
+                                           v8::Local<v8::FixedArray> importAssertions, v8::Local<v8::Module> referrer) {
+    v8::Isolate* isolate = context->GetIsolate();
+    uint32_t parentPathId = esModules.pathId(isolate, referrer);
+    uint32_t modulePathId = resolveRequire(isolate, parentPathId, specifier);
+    pendingEsEdges.emplace_back(parentPathId, modulePathId);
+    return getEsModule(isolate, context, modulePathId);
+}
+
+/**
+ * 把求值完成的 ES 模块注册到模块注册表，module.exports 为模块命名空间；
+ * 把静态 import 记录到依赖图，并在首次求值之后写入代码缓存
+ * @param isolate
+ * @param context
+ */
+void registerEsModules(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    std::vector<PendingEsModule> pending;
+    pending.swap(pendingEsModules);
+    for (const PendingEsModule& entry : pending) {
+        v8::Local<v8::Module> module;
+        if (!esModules.find(isolate, entry.pathId).ToLocal(&module) || module->GetStatus() == v8::Module::kErrored) {
+            continue;
+        }
+        if (module->GetStatus() == v8::Module::kUninstantiated) {
+            // 依赖解析失败，留到下一次实例化
+            pendingEsModules.push_back(entry);
+            continue;
+        }
+        uint32_t moduleId;
+        moduleRegistry.create(isolate, context, entry.pathId, module->GetModuleNamespace(), moduleId);
+        if (entry.produceCache) {
+            codeCache.save(pathTable.path(entry.pathId), entry.stamp, module->GetUnboundModuleScript());
+        }
+    }
+    for (const std::pair<uint32_t, uint32_t>& edge : pendingEsEdges) {
+        uint32_t parentModuleId = moduleRegistry.find(edge.first);
+        uint32_t moduleId = moduleRegistry.find(edge.second);
+        if (parentModuleId != kInvalidModuleId && moduleId != kInvalidModuleId) {
+            dependencyGraph.addEdge(parentModuleId, moduleId);
+        }
+    }
+    pendingEsEdges.clear();
+}
+
+v8::MaybeLocal<v8::Value> importModule(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t modulePathId,
+                                      uint32_t parentPathId, v8::Local<v8::Value>* evaluation) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    v8::Local<v8::Module> module;
+    if (!getEsModule(isolate, context, modulePathId).ToLocal(&module)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    // 实例化时 v8 通过 resolveEsModule 编译整张静态依赖图
+    if (module->GetStatus() == v8::Module::kUninstantiated &&
+        !module->InstantiateModule(context, resolveEsModule).FromMaybe(false)) {
+        return v8::MaybeLocal<v8::Value>();
+    }
+    v8::Local<v8::Value> result = v8::Undefined(isolate);
+    // 循环依赖中正在求值的模块直接返回命名空间
+    if (module->GetStatus() == v8::Module::kInstantiated) {
+        TraceSpan executeSpan(moduleTrace, "execute", pathTable.path(modulePathId).c_str());
+        if (!module->Evaluate(context).ToLocal(&result)) {
+            return v8::MaybeLocal<v8::Value>();
+        }
+    }
+    if (module->GetStatus() == v8::Module::kErrored) {
+        isolate->ThrowException(module->GetException());
+        return v8::MaybeLocal<v8::Value>();
+    }
+    registerEsModules(isolate, context);
+
+    uint32_t moduleId = moduleRegistry.find(modulePathId);
+    uint32_t parentModuleId = moduleRegistry.find(parentPathId);
+    if (moduleId != kInvalidModuleId) {
+        if (module->IsSourceTextModule()) {
+            recordLoadTime(moduleId, start);
+        }
+        if (parentModuleId != kInvalidModuleId) {
+            dependencyGraph.addEdge(parentModuleId, moduleId);
+        }
+    }
+    if (evaluation != nullptr) {
+        *evaluation = result;
+    }
+    return module->GetModuleNamespace();
+}
+
+/**
+ * 顶层 await 完成之后 import() 的结果，Data 为模块命名空间
+ * @param info
+ */
+void importFulfilled(const v8::FunctionCallbackInfo<v8::Value> &info) {
+    info.GetReturnValue().Set(info.Data());
 }
 
 /**
- * 判断字符串是否以某个 后缀为结尾
- * @param str
- * @param suffix
+ * import() 的实现。referrer 的资源名是发起 import() 的模块的绝对路径，相对于它所在的目录解析
+ * @param context
+ * @param referrer
+ * @param specifier
+ * @param importAssertions
  * @return
  */
-inline bool has_suffix(const std::string &str, const std::string &suffix){
-    return str.size() >= suffix.size() &&
-           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+v8::MaybeLocal<v8::Promise> importModuleDynamically(v8::Local<v8::Context> context, v8::Local<v8::ScriptOrModule> referrer,
+                                                   v8::Local<v8::String> specifier, v8::Local<v8::FixedArray> importAssertions) {
+    v8::Isolate* isolate = context->GetIsolate();
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::Promise::Resolver> resolver;
+    if (!v8::Promise::Resolver::New(context).ToLocal(&resolver)) {
+        return v8::MaybeLocal<v8::Promise>();
+    }
+    uint32_t parentPathId = kInvalidPathId;
+    v8::Local<v8::Value> resourceName = referrer->GetResourceName();
+    if (resourceName->IsString()) {
+        parentPathId = pathTable.find(*v8::String::Utf8Value(isolate, resourceName));
+    }
+    uint32_t modulePathId = resolveRequire(isolate, parentPathId, specifier);
+
+    v8::TryCatch tryCatch(isolate);
+    v8::Local<v8::Value> evaluation;
+    v8::Local<v8::Value> moduleNamespace;
+    if (!importModule(isolate, context, modulePathId, parentPathId, &evaluation).ToLocal(&moduleNamespace)) {
+        v8::Local<v8::Value> error = tryCatch.HasCaught() ? tryCatch.Exception() :
+                v8::Exception::Error(v8::String::NewFromUtf8Literal(isolate, "模块加载失败"));
+        tryCatch.Reset();
+        resolver->Reject(context, error).FromJust();
+    } else if (evaluation->IsPromise() && evaluation.As<v8::Promise>()->State() == v8::Promise::kPending) {
+        // 顶层 await 还没有完成，求值结束之后再交出命名空间
+        v8::Local<v8::Function> fulfilled = v8::Function::New(context, importFulfilled, moduleNamespace).ToLocalChecked();
+        resolver->Resolve(context, evaluation.As<v8::Promise>()->Then(context, fulfilled).ToLocalChecked()).FromJust();
+    } else {
+        resolver->Resolve(context, moduleNamespace).FromJust();
+    }
+    return handleScope.Escape(resolver->GetPromise());
+}
+
+/**
+ * 初始化 import.meta，url 为模块文件的 file:// 地址
+ * @param context
+ * @param module
+ * @param meta
+ */
+void initializeImportMeta(v8::Local<v8::Context> context, v8::Local<v8::Module> module, v8::Local<v8::Object> meta) {
+    v8::Isolate* isolate = context->GetIsolate();
+    uint32_t modulePathId = esModules.pathId(isolate, module);
+    if (modulePathId == kInvalidPathId) {
+        return;
+    }
+    std::string url = "file://" + pathTable.path(modulePathId);
+    meta->CreateDataProperty(context, v8::String::NewFromUtf8Literal(isolate, "url"),
+                             v8::String::NewFromUtf8(isolate, url.data(), v8::NewStringType::kNormal, static_cast<int>(url.size())).ToLocalChecked()).FromJust();
 }
+
 /**
- * require 函数的实现,用于模块的获取。
+ * require 函数的实现,用于模块的获取。require 对象的调用处理函数，Holder 为 require 对象本身
  * @param info
  */
 void require(const v8::FunctionCallbackInfo<v8::Value> &info) {
@@ -93,92 +1131,83 @@ void require(const v8::FunctionCallbackInfo<v8::Value> &info) {
     v8::Local<v8::Context> context = isolate->GetCurrentContext();
     v8::HandleScope handleScope(isolate);
 
-    v8::Local<v8::Object> moduleCache = v8::Local<v8::Object>::New(isolate, cache);
-    v8::Local<v8::String> moduleId = v8::Local<v8::String>::New(isolate, currentModuleId);
-    std::string modulePath(*v8::String::Utf8Value(isolate, info[0].As<v8::String>()));
-    if (!has_suffix(modulePath, std::string(".js"))) {
-        modulePath.append(".js");
-    }
-
-    std::string  moduleDir(*v8::String::Utf8Value(isolate, moduleId));
-    std::string  parentModuleId = moduleDir;
-    // 获取夫模块的目录
-    if (moduleDir.find(std::string("."))  != -1) {
-        int index = moduleDir.find_last_of("/");
-        moduleDir = moduleDir.substr(0, index);
-    }
-    // 父模块id
-    std::string moduleAbsolutePath = getAbsolutePath(modulePath, moduleDir);
-
-    // 查找缓存
-    v8::Local<v8::Value> module = moduleCache->Get(context, v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked()).ToLocalChecked();
-    // 如果命中缓存，直接使用缓存
-    // 这里注意的是，在javaScript 获取一个属性的时候如果属性不存在，返回的是 undefined
-    if (!module.IsEmpty() && !module->IsUndefined()){
-        info.GetReturnValue().Set(module);
+    v8::Local<v8::Value> exports;
+    if (requireModule(isolate, context, requireOwner(isolate, info.Holder()), info[0]).ToLocal(&exports)) {
+        info.GetReturnValue().Set(exports);
         return;
     }
-    // 读取原文件
-    v8::Local<v8::String> source = readFile(moduleAbsolutePath);
+    info.GetReturnValue().SetNull();
+}
 
-    if (source.IsEmpty()) {
+/**
+ * require.lazy 的实现。返回模块的占位对象，第一次访问占位对象的属性时才加载模块
+ * require.lazy('path').method()
+ * exports 是函数时需要声明 require.lazy('path', { callable: true })，占位对象才可以调用和 new
+ * @param info
+ */
+void lazyRequire(const v8::FunctionCallbackInfo<v8::Value> &info) {
+    if (!info.Length() || !info[0]->IsString()) {
         info.GetReturnValue().SetNull();
         return;
     }
-
-    // 构建脚本
-    v8::Local<v8::Script> script = v8::Script::Compile(context, source).ToLocalChecked();
-
-    // 把当前文件作为当前模块id
-    currentModuleId.Reset(isolate, v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked());
-    // 执行模块
-    script->Run(context).ToLocalChecked();
-    // 从缓存模块中获取
-    module = moduleCache->Get(context, v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked()).ToLocalChecked();
-    if (!module.IsEmpty() && !module->IsUndefined()) {
-        v8::Local<v8::Object> exports = module.As<v8::Object>()->Get(context, v8::String::NewFromUtf8Literal(isolate, "exports")).ToLocalChecked().As<v8::Object>();
-        if (!exports.IsEmpty() && !exports->IsUndefined()) {
-            v8::Local<v8::Object> parentModule = moduleCache->Get(context, v8::String::NewFromUtf8(isolate, parentModuleId.c_str()).ToLocalChecked()).ToLocalChecked().As<v8::Object>();
-            // 获取父模块。把当前模块设置到夫模块的依赖项中。
-            if (!parentModule.IsEmpty() && !parentModule->IsUndefined()) {
-                // 获取模块的依赖数组
-                v8::Local<v8::Array> dependencies = parentModule->Get(context, v8::String::NewFromUtf8Literal(isolate, "dependencies")).ToLocalChecked().As<v8::Array>();
-                int length = dependencies->Length();
-                bool isFind = false;
-                // 防止重复添加
-                for (int index = 0; index < length; ++index) {
-                    v8::Local<v8::String> depend = dependencies->Get(context, index).ToLocalChecked().As<v8::String>();
-                    if (depend->StrictEquals(v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked())){
-                        isFind = true;
-                        break;
-                    }
-                }
-                if (!isFind) {
-                    // 把当前模块添加到父模块中
-                    dependencies->Set(context, length, v8::String::NewFromUtf8(isolate, moduleAbsolutePath.c_str()).ToLocalChecked()).FromJust();
-                }
-            }
-            info.GetReturnValue().Set(exports);
+    v8::Isolate* isolate = info.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    // 在创建时解析路径，加载时记录为 require 对象所属模块的依赖
+    uint32_t parentPathId = requireOwner(isolate, info.This());
+    uint32_t modulePathId = resolveRequire(isolate, parentPathId, info[0]);
+    bool callable = false;
+    if (info.Length() > 1 && info[1]->IsObject()) {
+        v8::Local<v8::Value> value;
+        if (!info[1].As<v8::Object>()->Get(context, v8::String::NewFromUtf8Literal(isolate, "callable")).ToLocal(&value)) {
             return;
         }
+        callable = value->BooleanValue(isolate);
     }
-    info.GetReturnValue().SetNull();
+    info.GetReturnValue().Set(lazyExports(isolate, context, modulePathId, parentPathId, callable));
+}
+
+/**
+ * require.resolve 的实现，返回模块的绝对路径，但不加载模块。与 require 共用路径解析缓存。
+ * @param info
+ */
+void resolve(const v8::FunctionCallbackInfo<v8::Value> &info) {
+    if (!info.Length() || !info[0]->IsString()) {
+        info.GetReturnValue().SetNull();
+        return;
+    }
+    v8::Isolate* isolate = info.GetIsolate();
+    uint32_t modulePathId = resolveRequire(isolate, requireOwner(isolate, info.This()), info[0]);
+    info.GetReturnValue().Set(newPathString(isolate, modulePathId));
 }
 
 /**
- * 异步获取模块
+ * require.graph 的实现，返回已加载模块的依赖图
+ * { modules: [{ id, uri, loadTime, dependencies: [id...] }] }，loadTime 为包含依赖在内的加载耗时(毫秒)
+ * @param info
+ */
+void graph(const v8::FunctionCallbackInfo<v8::Value> &info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    info.GetReturnValue().Set(dependencyGraph.toObject(isolate, isolate->GetCurrentContext()));
+}
+
+/**
+ * 异步获取模块。模块在后台线程读取和编译，完成之后在 isolate 线程上执行，当前模块的执行不会被阻塞。
  * 在commonjs 文件中使用
  * define(function(require, export, module) {
  *     require.async('path', (module1) => {
  *     });
- *     const module2 = require('path');
+ *     const module2 = await require.async('path');
+ *     require.async(['path1', 'path2'], (module3, module4) => {
+ *     });
+ *     const module5 = require('path');
  * })
  * @param info
  */
 void async(const v8::FunctionCallbackInfo<v8::Value> &info) {
 
-    // 参数校验。async必须两个参数，第一个为字符串路径。第二个为回调函数。
-    if (info.Length() != 2 || !info[0]->IsString() && !info[1]->IsFunction()) {
+    // 参数校验。第一个参数为字符串路径或者路径数组，第二个为可选的回调函数，没有回调函数时返回 Promise
+    if (!info.Length() || !(info[0]->IsString() || info[0]->IsArray()) ||
+        (info.Length() > 1 && !info[1]->IsFunction() && !info[1]->IsUndefined())) {
         info.GetReturnValue().SetNull();
         return;
     }
@@ -186,31 +1215,70 @@ void async(const v8::FunctionCallbackInfo<v8::Value> &info) {
     v8::HandleScope handleScope(isolate);
     v8::Local<v8::Context> context = isolate->GetCurrentContext();
 
-    // 把参数设置到对象params。用于创建微任务队列的回调函数。把该对象作为参数
-    v8::Local<v8::Object> params = v8::Object::New(isolate);
-    params->Set(context, v8::String::NewFromUtf8Literal(isolate, "modulePath"), info[0]).FromJust();
-    params->Set(context, v8::String::NewFromUtf8Literal(isolate, "callBack"), info[1]).FromJust();
-
-    // 存放在微任务队列中。
-    isolate->EnqueueMicrotask(v8::Function::New(context, [](const v8::FunctionCallbackInfo<v8::Value> &info) -> void {
-        v8::Isolate* isolate = info.GetIsolate();
-        v8::HandleScope handleScope(isolate);
-        v8::Local<v8::Context> context = isolate->GetCurrentContext();
-        v8::Local<v8::Object> params = info.Data().As<v8::Object>();
-        v8::Local<v8::Function> requireFun = v8::Function::New(context, require).ToLocalChecked();
-        v8::Local<v8::Value> args[] = { params->Get(context, v8::String::NewFromUtf8Literal(isolate, "modulePath")).ToLocalChecked() };
-        v8::Local<v8::Value> result = requireFun->Call(context, context->Global(), 1, args).ToLocalChecked();
-        v8::Local<v8::Function> callBack = params->Get(context, v8::String::NewFromUtf8Literal(isolate, "callBack")).ToLocalChecked().As<v8::Function>();
-
-        // 执行async 函数的回调
-        if (result.IsEmpty() || result->IsUndefined()) {
-            v8::Local<v8::Value> argv[] = { v8::Null(isolate) };
-            callBack->Call(context, context->Global(), 1, argv).ToLocalChecked();
-        } else {
-            v8::Local<v8::Value> argv[] = { result };
-            callBack->Call(context, context->Global(), 1, argv).ToLocalChecked();
+    // 回调执行时正在执行的模块已经变化，在调用时确定父模块并解析路径
+    uint32_t parentPathId = requireOwner(isolate, info.This());
+    v8::Local<v8::Function> callback;
+    if (info.Length() > 1 && info[1]->IsFunction()) {
+        callback = info[1].As<v8::Function>();
+    }
+    if (info[0]->IsString()) {
+        uint32_t modulePathId = resolveRequire(isolate, parentPathId, info[0]);
+        info.GetReturnValue().Set(asyncRequires.require(isolate, context, modulePathId, parentPathId, callback));
+        return;
+    }
+    // require.async(['a', 'b'], (a, b) => {}) 一次加载一组模块，全部就绪之后回调一次
+    v8::Local<v8::Array> paths = info[0].As<v8::Array>();
+    std::vector<uint32_t> modulePathIds;
+    modulePathIds.reserve(paths->Length());
+    for (uint32_t index = 0; index < paths->Length(); ++index) {
+        v8::Local<v8::Value> path;
+        if (!paths->Get(context, index).ToLocal(&path) || !path->IsString()) {
+            info.GetReturnValue().SetNull();
+            return;
         }
-    }, params).ToLocalChecked());
+        modulePathIds.push_back(resolveRequire(isolate, parentPathId, path));
+    }
+    info.GetReturnValue().Set(asyncRequires.requireAll(isolate, context, modulePathIds, parentPathId, callback));
+}
+
+/**
+ * require.cache 的访问器，返回注册表的只读视图
+ * @param property
+ * @param info
+ */
+void requireCacheGetter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    info.GetReturnValue().Set(requireCache.Get(info.GetIsolate()));
+}
+
+/**
+ * 创建 require 模板。v8 的 FunctionTemplate 的 Data 在模板上是固定的，不能按模块区分，
+ * 因此 require 是一个可调用的对象：调用处理函数为 require，所属模块 id 以 Smi 保存在内部字段里，
+ * async、resolve、lazy、graph 是模板上的函数，同一个上下文中的所有 require 对象共用，
+ * 通过 this 找到所属模块。每个模块只需要实例化一次模板，不再为每个模块创建 5 个函数。
+ * @param isolate
+ * @return
+ */
+v8::Local<v8::FunctionTemplate> newRequireTemplate(v8::Isolate* isolate) {
+    v8::Local<v8::FunctionTemplate> functionTemplate = v8::FunctionTemplate::New(isolate);
+    functionTemplate->SetClassName(v8::String::NewFromUtf8Literal(isolate, "require"));
+    v8::Local<v8::ObjectTemplate> objectTemplate = functionTemplate->InstanceTemplate();
+    objectTemplate->SetInternalFieldCount(kRequireFieldCount);
+    objectTemplate->SetCallAsFunctionHandler(require);
+    objectTemplate->Set(isolate, "async", v8::FunctionTemplate::New(isolate, async));
+    objectTemplate->Set(isolate, "resolve", v8::FunctionTemplate::New(isolate, resolve));
+    objectTemplate->Set(isolate, "lazy", v8::FunctionTemplate::New(isolate, lazyRequire));
+    objectTemplate->Set(isolate, "graph", v8::FunctionTemplate::New(isolate, graph));
+    objectTemplate->SetAccessor(v8::String::NewFromUtf8Literal(isolate, "cache"), requireCacheGetter, nullptr,
+                                v8::Local<v8::Value>(), v8::DEFAULT, v8::ReadOnly);
+    return functionTemplate;
+}
+
+v8::Local<v8::Object> newRequireFunction(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t moduleId) {
+    v8::Local<v8::Object> requireFun = requireTemplate.Get(isolate)->InstanceTemplate()->NewInstance(context).ToLocalChecked();
+    if (moduleId != kInvalidModuleId) {
+        requireFun->SetInternalField(kRequireOwnerField, v8::Integer::NewFromUnsigned(isolate, moduleId));
+    }
+    return requireFun;
 }
 
 /**
@@ -230,59 +1298,678 @@ void define(const v8::FunctionCallbackInfo<v8::Value> &info) {
         return;
     }
 
-    // 把正在执行的持久化moduleId 和模块缓存对象本地化。
-    v8::Local<v8::Object> moduleCache = v8::Local<v8::Object>::New(isolate, cache);
-    v8::Local<v8::String> moduleId = v8::Local<v8::String>::New(isolate, currentModuleId);
+    // 正在执行的模块
+    uint32_t modulePathId = moduleRegistry.loading();
+    if (modulePathId == kInvalidPathId) {
+        isolate->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8Literal(isolate, "define 只能在模块加载时调用")));
+        return;
+    }
 
-    // 构建 module对象， module.exports对象
-    v8::Local<v8::Object> module = v8::Object::New(isolate);
-    module->Set(context, v8::String::NewFromUtf8Literal(isolate, "uri"), moduleId).FromJust();
-    // 把模块设置到缓存里面
-    moduleCache->Set(context, moduleId, module).FromJust();
+    // 构建 module对象并设置到缓存里面。函数模块的 exports 为新对象，否则为 define 的参数；dependencies 为依赖图的只读视图。
+    v8::Local<v8::Value> exports = info[0]->IsFunction() ? v8::Object::New(isolate).As<v8::Value>() : info[0];
+    uint32_t moduleIndex;
+    v8::Local<v8::Object> module = moduleRegistry.create(isolate, context, modulePathId, exports, moduleIndex);
     if (info[0]->IsFunction()) {
-        v8::Local<v8::Object> exports = v8::Object::New(isolate);
-        // 设置module对象的 exports和 dependencies属性。exports为对象。 dependencies为数组。
-        module->Set(context, v8::String::NewFromUtf8Literal(isolate, "exports"), exports).FromJust();
-        module->Set(context, v8::String::NewFromUtf8Literal(isolate, "dependencies"), v8::Array::New(isolate)).FromJust();
-
         v8::Local<v8::Function> moduleCallBack = info[0].As<v8::Function>();
         // 构建require 函数
-        v8::Local<v8::Function> requireFun =  v8::Function::New(context, require).ToLocalChecked();
-        // 为require 函数增加 async 函数属性
-        requireFun->Set(context, v8::String::NewFromUtf8Literal(isolate, "async"), v8::Function::New(context, async).ToLocalChecked()).FromJust();
+        v8::Local<v8::Object> requireFun = newRequireFunction(isolate, context, moduleIndex);
         v8::Local<v8::Value> argv[] = { requireFun, exports, module};
         // 执行define 的参数回调
         moduleCallBack->Call(context, context->Global(), 3, argv).ToLocalChecked();
+    }
+}
+
+/**
+ * 全局函数 print 的实现，用于打印结果
+ * @param info
+ */
+void print(const v8::FunctionCallbackInfo <v8::Value> &info) {
+    v8::Isolate *isolate = info.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    // 如果是普通的对象，直接转成JSON字符串。如果是其他类型强制转换成字符串输出。
+    if (!info[0]->IsNull() && info[0]->IsObject() && !info[0]->IsFunction()) {
+        std::cout << *v8::String::Utf8Value(isolate, v8::JSON::Stringify(context, info[0]).ToLocalChecked()) << std::endl;
     } else {
-        module->Set(context, v8::String::NewFromUtf8Literal(isolate, "exports"), info[0]).FromJust();
+        std::cout << *v8::String::Utf8Value(isolate, info[0].As<v8::String>()) << std::endl;
     }
 }
 
+/**
+ * 会被保存到快照里的 c++ 回调函数。反序列化时 v8 通过这张表重新关联函数地址，
+ * 所有挂到上下文中的原生函数都必须登记在这里，以 0 结尾。
+ */
+intptr_t externalReferences[] = {
+    reinterpret_cast<intptr_t>(require),
+    reinterpret_cast<intptr_t>(async),
+    reinterpret_cast<intptr_t>(resolve),
+    reinterpret_cast<intptr_t>(lazyRequire),
+    reinterpret_cast<intptr_t>(graph),
+    reinterpret_cast<intptr_t>(requireCacheGetter),
+    reinterpret_cast<intptr_t>(importFulfilled),
+    reinterpret_cast<intptr_t>(evaluateCommonJsModule),
+    reinterpret_cast<intptr_t>(define),
+    reinterpret_cast<intptr_t>(print),
+    reinterpret_cast<intptr_t>(ModuleRegistry::cacheGetter),
+    reinterpret_cast<intptr_t>(ModuleRegistry::cacheSetter),
+    reinterpret_cast<intptr_t>(ModuleRegistry::cacheQuery),
+    reinterpret_cast<intptr_t>(ModuleRegistry::cacheDeleter),
+    reinterpret_cast<intptr_t>(ModuleRegistry::cacheEnumerator),
+    reinterpret_cast<intptr_t>(LazyModules::loadCallback),
+    reinterpret_cast<intptr_t>(LazyModules::targetCall),
+    reinterpret_cast<intptr_t>(DependencyGraph::dependenciesGetter),
+    reinterpret_cast<intptr_t>(WasmModules::streamingCallback),
+    0
+};
 
+// 快照中模块上下文的索引
+const size_t kSnapshotContextIndex = 0;
+// 快照中 require 模板的 isolate 数据索引，恢复之后快照里的 require 对象仍然是模板的实例
+const size_t kSnapshotRequireTemplateIndex = 0;
+// 快照上下文中模块数组的数据索引，数组按模块 id 保存 module 对象
+const size_t kSnapshotModulesIndex = 0;
+// 快照上下文中依赖图的数据索引
+const size_t kSnapshotGraphIndex = 1;
+// 快照上下文中惰性模块共享状态的数据索引
+const size_t kSnapshotLazyIndex = 2;
+
+/**
+ * 命令行参数
+ */
+struct Options {
+    // 主模块路径
+    const char* entry = nullptr;
+    // --no-code-cache 关闭代码缓存
+    bool codeCache = true;
+    // --code-cache-stats 退出时输出代码缓存的命中统计
+    bool codeCacheStats = false;
+    // --build-snapshot <entry> 执行主模块之后把上下文序列化成快照
+    bool buildSnapshot = false;
+    // -o <file> 快照或者模块归档的输出文件
+    const char* output = nullptr;
+    // --snapshot <blob> 从快照恢复上下文
+    const char* snapshot = nullptr;
+    // --no-prefetch 关闭依赖的后台预取
+    bool prefetch = true;
+    // --record-load-order <file> 退出时写入模块的加载顺序
+    const char* recordLoadOrder = nullptr;
+    // --replay-load-order <file> 主模块执行之前并行预取记录中的所有模块
+    const char* replayLoadOrder = nullptr;
+    // pack <entry> -o <archive> 把主模块及其依赖打包成模块归档
+    bool pack = false;
+    // analyze-startup <entry> 主模块同步执行完、进入事件循环之前输出启动关键路径、模块耗时和延迟加载的收益
+    bool analyzeStartup = false;
+    // --with-code-cache 打包时写入代码缓存
+    bool withCodeCache = false;
+    // --archive <file> 从模块归档加载模块，没有指定主模块时执行归档中的主模块
+    const char* archive = nullptr;
+    // --lazy <path> 惰性加载的模块，可以指定多次。require 这些模块时返回占位对象
+    std::vector<const char*> lazy;
+    // --dump-graph=json|dot 退出时把依赖图输出到 stderr
+    std::string dumpGraph;
+    // --watch 主模块执行之后监听模块文件，文件变化时重新加载该模块和依赖它的模块
+    bool watch = false;
+    // --record-compile-hints <file> 采样执行过的函数，退出时写入编译提示
+    const char* recordCompileHints = nullptr;
+    // --compile-hints <file> 立即编译提示中的热模块
+    const char* compileHints = nullptr;
+    // --trace-modules=<file> 把模块加载各阶段的耗时写成 Chrome trace JSON
+    std::string traceModules;
+};
+
+/**
+ * 解析命令行参数。以 -- 开头的为选项，第一个非选项参数为主模块路径
+ * @param args
+ * @param argv
+ * @param options
+ * @return 参数是否合法
+ */
+bool parseOptions(int args, char** argv, Options& options) {
+    int first = 1;
+    if (args > 1 && std::string(argv[1]) == "pack") {
+        options.pack = true;
+        first = 2;
+    } else if (args > 1 && std::string(argv[1]) == "analyze-startup") {
+        options.analyzeStartup = true;
+        first = 2;
+    }
+    for (int index = first; index < args; ++index) {
+        std::string arg(argv[index]);
+        // 需要带值的参数
+        bool hasValue = index + 1 < args;
+        if (arg == "--no-code-cache") {
+            options.codeCache = false;
+        } else if (arg == "--code-cache-stats") {
+            options.codeCacheStats = true;
+        } else if (arg == "--record-compile-hints" && hasValue) {
+            options.recordCompileHints = argv[++index];
+        } else if (arg == "--compile-hints" && hasValue) {
+            options.compileHints = argv[++index];
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--no-prefetch") {
+            options.prefetch = false;
+        } else if (arg == "--record-load-order" && hasValue) {
+            options.recordLoadOrder = argv[++index];
+        } else if (arg == "--replay-load-order" && hasValue) {
+            options.replayLoadOrder = argv[++index];
+        } else if (arg == "--build-snapshot" && hasValue) {
+            options.buildSnapshot = true;
+            options.entry = argv[++index];
+        } else if (arg == "-o" && hasValue) {
+            options.output = argv[++index];
+        } else if (arg == "--with-code-cache") {
+            options.withCodeCache = true;
+        } else if (arg == "--archive" && hasValue) {
+            options.archive = argv[++index];
+        } else if (arg == "--dump-graph=json" || arg == "--dump-graph=dot") {
+            options.dumpGraph = arg.substr(arg.find('=') + 1);
+        } else if (arg.compare(0, 16, "--trace-modules=") == 0 && arg.size() > 16) {
+            options.traceModules = arg.substr(16);
+        } else if (arg == "--lazy" && hasValue) {
+            options.lazy.push_back(argv[++index]);
+        } else if (arg == "--snapshot" && hasValue) {
+            options.snapshot = argv[++index];
+        } else if (arg.compare(0, 1, "-") == 0) {
+            std::cerr << "未知参数: " << arg << std::endl;
+            return false;
+        } else if (options.entry == nullptr) {
+            options.entry = argv[index];
+        }
+    }
+    return options.entry != nullptr || (options.archive != nullptr && !options.pack && !options.buildSnapshot);
+}
+
+/**
+ * 初始化一个全新的上下文：全局函数 define、print
+ * @param isolate
+ * @param context
+ */
+void installGlobals(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    // 设置全局函数 define
+    context->Global()->Set(context, v8::String::NewFromUtf8Literal(isolate, "define"), v8::Function::New(context, define).ToLocalChecked()).FromJust();
+    // 设置全局函数用于打印结果
+    context->Global()->Set(context, v8::String::NewFromUtf8Literal(isolate, "print"), v8::Function::New(context, print).ToLocalChecked()).FromJust();
+}
+
+/**
+ * 把注册表中的模块按 id 顺序导出成数组，用于写入快照
+ * @param isolate
+ * @param context
+ * @return
+ */
+v8::Local<v8::Array> exportModules(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    v8::Local<v8::Array> modules = v8::Array::New(isolate, static_cast<int>(moduleRegistry.size()));
+    for (uint32_t moduleId = 0; moduleId < moduleRegistry.size(); ++moduleId) {
+        modules->Set(context, moduleId, moduleRegistry.get(isolate, moduleId)).FromJust();
+    }
+    return modules;
+}
+
+/**
+ * 用快照中的模块数组重建注册表，模块路径取自 module.uri
+ * @param isolate
+ * @param context
+ * @param modules
+ */
+void importModules(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Array> modules) {
+    v8::Local<v8::String> uriKey = moduleRegistry.uriKey(isolate);
+    for (uint32_t index = 0; index < modules->Length(); ++index) {
+        v8::Local<v8::Object> module = modules->Get(context, index).ToLocalChecked().As<v8::Object>();
+        v8::Local<v8::Value> uri = module->Get(context, uriKey).ToLocalChecked();
+        moduleRegistry.add(isolate, pathTable.intern(*v8::String::Utf8Value(isolate, uri)), module);
+    }
+}
+
+/**
+ * 加载主模块，清空微任务队列，然后运行事件循环直到没有被引用的句柄、定时器和 require.async 请求
+ * @param isolate
+ * @param context
+ * @param entry 主模块路径
+ * @param analyzeStartup 主模块同步执行完、进入事件循环之前输出启动分析报告。服务器的事件循环不会返回
+ */
+void runEntry(v8::Isolate* isolate, v8::Local<v8::Context> context, const char* entry, bool analyzeStartup) {
+    // 创建主模块的 require 函数，相对于工作目录解析
+    v8::Local<v8::Object> requireFun = newRequireFunction(isolate, context, kInvalidModuleId);
+    v8::Local<v8::Value> args[] = { v8::String::NewFromUtf8(isolate, entry).ToLocalChecked() };
+    // 加载主模块
+    requireFun->CallAsFunction(context, context->Global(), 1, args).ToLocalChecked();
+    //情况微任务队列。
+    isolate->PerformMicrotaskCheckpoint();
+    // 服务器不会正常退出，主模块执行完成时写入 require.async 编译之后还无法序列化的 wasm 缓存
+    wasmModules.saveCaches();
+    if (analyzeStartup) {
+        StartupAnalyzer analyzer(dependencyGraph, moduleRegistry);
+        analyzer.report(std::cout, moduleRegistry.find(pathResolver.resolve(workDirId, entry)), 20);
+        std::cout.flush();
+    }
+    // 主模块是第一个宏任务，之后由事件循环驱动
+    if (!eventLoop.run(isolate)) {
+        std::cerr << "事件循环出错" << std::endl;
+    }
+}
+
+/**
+ * 热重载发生变化的模块。沿依赖图的反向边找到所有直接或间接依赖它们的模块，全部驱逐之后按模块 id 升序重新加载。
+ * 父模块总是先于子模块注册，升序加载时父模块重新执行会 require 到新的子模块；
+ * 没有被驱逐的模块直接命中缓存，重新加载的开销只与变化的子图大小有关。
+ * @param isolate
+ * @param context
+ * @param changedPaths 发生变化的模块路径 id
+ */
+void reloadModules(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::vector<uint32_t>& changedPaths) {
+    v8::HandleScope handleScope(isolate);
+    std::vector<uint32_t> changed;
+    for (uint32_t pathId : changedPaths) {
+        uint32_t moduleId = moduleRegistry.find(pathId);
+        if (moduleId != kInvalidModuleId) {
+            changed.push_back(moduleId);
+        }
+    }
+    // 变化的文件不再使用之前的预取结果(映射着改写之前的文件)
+    for (uint32_t pathId : changedPaths) {
+        prefetcher.forget(pathId);
+    }
+    if (changed.empty()) {
+        return;
+    }
+    std::vector<uint32_t> affected = dependencyGraph.transitiveDependents(changed);
+    for (uint32_t moduleId : affected) {
+        // 出边由重新执行时的 require 重建
+        dependencyGraph.removeDependencies(moduleId);
+        moduleRegistry.evict(moduleId);
+        esModules.remove(isolate, moduleRegistry.pathId(moduleId));
+        prefetcher.forget(moduleRegistry.pathId(moduleId));
+    }
+    // 占位对象缓存的 exports 可能是刚刚驱逐的模块
+    lazyModules.invalidate(isolate, context);
+    for (uint32_t moduleId : affected) {
+        uint32_t pathId = moduleRegistry.pathId(moduleId);
+        // 可能已经被先重新加载的父模块 require 过了
+        if (moduleRegistry.find(pathId) == kInvalidModuleId) {
+            loadModule(isolate, context, pathId, kInvalidPathId);
+        }
+    }
+    std::cerr << "reloaded " << affected.size() << " module(s)" << std::endl;
+}
+
+/**
+ * --watch 模式下把模块文件监听注册到事件循环，模块文件变化时在宏任务中热重载。
+ * inotify 句柄一直被引用，循环不会退出
+ * @param isolate
+ * @param context
+ */
+void watchModules(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    v8::Global<v8::Context> watchedContext(isolate, context);
+    bool listening = moduleWatcher.listen(eventLoop, [isolate, &watchedContext](const std::vector<uint32_t>& changed) {
+        reloadModules(isolate, watchedContext.Get(isolate), changed);
+    });
+    if (!listening || !eventLoop.run(isolate)) {
+        std::cerr << "监听模块文件失败" << std::endl;
+    }
+}
+
+/**
+ * 结束编译提示的记录：写入提示文件，并为热模块重新生成代码缓存。
+ * 此时的缓存包含预热期间编译过的所有函数，之后的启动直接反序列化，不需要再惰性编译。
+ * @param isolate
+ * @param file 提示文件
+ * @return 是否成功
+ */
+bool finishCompileHints(v8::Isolate* isolate, const char* file) {
+    v8::HandleScope handleScope(isolate);
+    compileHints.stopRecording(isolate, pathTable);
+    for (const RecordedScript& recorded : recordedScripts) {
+        if (!compileHints.isHot(recorded.pathId)) {
+            continue;
+        }
+        if (!recorded.function.IsEmpty()) {
+            codeCache.save(pathTable.path(recorded.pathId), recorded.stamp, recorded.function.Get(isolate));
+        } else {
+            codeCache.save(pathTable.path(recorded.pathId), recorded.stamp, recorded.script.Get(isolate));
+        }
+    }
+    recordedScripts.clear();
+    return compileHints.save(file, pathTable);
+}
+
+/**
+ * 预取加载顺序记录中的所有模块
+ * @param isolate
+ * @param file 记录文件
+ */
+void replayLoadOrder(v8::Isolate* isolate, const char* file) {
+    std::vector<std::string> paths;
+    if (!LoadOrder::load(file, paths)) {
+        std::cerr << "读取加载顺序失败: " << file << std::endl;
+        return;
+    }
+    for (const std::string& path : paths) {
+        prefetcher.prefetch(isolate, pathTable.intern(path));
+    }
+}
+
+/**
+ * 构建启动快照。执行主模块(通常是框架的入口)，把加载完成的上下文和模块缓存一起序列化到文件。
+ * @param options
+ * @param workDir 工作目录
+ * @return 进程退出码
+ */
+int buildSnapshot(const Options& options, const char* workDir) {
+    v8::StartupData blob;
+    {
+        // SnapshotCreator 会创建并进入 isolate
+        v8::SnapshotCreator creator(externalReferences);
+        v8::Isolate* isolate = creator.GetIsolate();
+        {
+            v8::HandleScope handleScope(isolate);
+            isolate->SetMicrotasksPolicy(v8::MicrotasksPolicy::kExplicit);
+            // 编译好的 wasm 模块无法写入快照
+            wasmModules.attach(isolate);
+            wasmModules.setEnabled(false);
+            creator.SetDefaultContext(v8::Context::New(isolate));
+
+            v8::Local<v8::Context> context = v8::Context::New(isolate);
+            v8::Context::Scope context_scope(context);
+            moduleRegistry.attach(isolate);
+            lazyModules.attach(isolate);
+            dependencyGraph.attach(isolate);
+            dependencyGraph.installView(isolate, moduleRegistry.moduleTemplate(isolate));
+            isolate->SetHostImportModuleDynamicallyCallback(importModuleDynamically);
+            isolate->SetHostInitializeImportMetaObjectCallback(initializeImportMeta);
+            // 原生函数的地址不在 external references 中，无法序列化
+            nativeAddons.setEnabled(false);
+            enterWorkDir(workDir);
+            requireTemplate.Reset(isolate, newRequireTemplate(isolate));
+            installGlobals(isolate, context);
+            requireCache.Reset(isolate, moduleRegistry.newCacheView(isolate, context));
+            runEntry(isolate, context, options.entry, false);
+
+            // 快照中不能包含还在后台编译的脚本
+            prefetcher.shutdown();
+            creator.AddData(context, exportModules(isolate, context));
+            creator.AddData(context, dependencyGraph.exportGraph(isolate, context));
+            creator.AddData(context, lazyModules.exportState(isolate, context));
+            // module 对象和 require 对象的内部字段保存模块 id
+            creator.AddContext(context, v8::SerializeInternalFieldsCallback(ModuleRegistry::serializeModuleId));
+            creator.AddData(requireTemplate.Get(isolate));
+            // 快照中不能存在持久化句柄
+            requireTemplate.Reset();
+            requireCache.Reset();
+            esModules.clear();
+            moduleRegistry.clear();
+            lazyModules.reset();
+        }
+        // 保留已经编译的函数代码，恢复之后不需要再次编译
+        blob = creator.CreateBlob(v8::SnapshotCreator::FunctionCodeHandling::kKeep);
+    }
+    if (blob.data == nullptr) {
+        std::cerr << "构建快照失败" << std::endl;
+        return 1;
+    }
+    const char* output = options.output != nullptr ? options.output : "snapshot.blob";
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    out.write(blob.data, blob.raw_size);
+    out.close();
+    delete[] blob.data;
+    if (!out) {
+        std::cerr << "写入快照失败: " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * 为打包的模块生成代码缓存。预热运行留下的有效缓存文件包含执行过的函数，优先使用；
+ * 否则编译(不执行)模块生成缓存。
+ * @param modules 打包的模块
+ * @param pathIds 模块的绝对路径 id
+ * @param stamps 模块源码版本戳
+ */
+void createArchiveCodeCache(std::vector<ArchiveModule>& modules, const std::vector<uint32_t>& pathIds,
+                            const std::vector<SourceStamp>& stamps) {
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    {
+        v8::Isolate::Scope isolate_scope(isolate);
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> context = v8::Context::New(isolate);
+        v8::Context::Scope context_scope(context);
+        for (size_t index = 0; index < modules.size(); ++index) {
+            const std::string& path = pathTable.path(pathIds[index]);
+            CodeCache::Lookup lookup;
+            std::unique_ptr<v8::ScriptCompiler::CachedData> data(codeCache.read(path, stamps[index], lookup));
+            if (isWasmPath(path)) {
+                // wasm 的编译结果只能在流式编译中使用，归档中不保存
+                continue;
+            }
+            if (!data && isJsonPath(path)) {
+                // JSON 模块的缓存是解析结果的序列化，小文件直接解析更快，不生成缓存
+                v8::HandleScope scope(isolate);
+                v8::TryCatch tryCatch(isolate);
+                v8::Local<v8::Value> value;
+                if (modules[index].source.size() >= kJsonCacheThreshold &&
+                    v8::JSON::Parse(context, v8::String::NewFromUtf8(isolate, modules[index].source.data(), v8::NewStringType::kNormal,
+                                                                     static_cast<int>(modules[index].source.size())).ToLocalChecked()).ToLocal(&value)) {
+                    data.reset(serializeJson(isolate, context, value));
+                }
+            } else if (!data) {
+                v8::HandleScope scope(isolate);
+                bool esModule = isEsModulePath(path);
+                v8::ScriptOrigin origin(isolate, v8::String::NewFromUtf8(isolate, path.c_str()).ToLocalChecked(), 0, 0, false, -1,
+                                        v8::Local<v8::Value>(), false, false, esModule);
+                v8::ScriptCompiler::Source source(v8::String::NewFromUtf8(isolate, modules[index].source.data(), v8::NewStringType::kNormal,
+                                                                          static_cast<int>(modules[index].source.size())).ToLocalChecked(), origin);
+                // 缓存的类型必须与运行时的编译方式一致
+                if (esModule) {
+                    v8::Local<v8::Module> module;
+                    if (!v8::ScriptCompiler::CompileModule(isolate, &source).ToLocal(&module)) {
+                        std::cerr << "编译失败: " << path << std::endl;
+                        continue;
+                    }
+                    data.reset(v8::ScriptCompiler::CreateCodeCache(module->GetUnboundModuleScript()));
+                } else if (isDefineModule(modules[index].source.data(), modules[index].source.size())) {
+                    v8::Local<v8::UnboundScript> script;
+                    if (!v8::ScriptCompiler::CompileUnboundScript(isolate, &source).ToLocal(&script)) {
+                        std::cerr << "编译失败: " << path << std::endl;
+                        continue;
+                    }
+                    data.reset(v8::ScriptCompiler::CreateCodeCache(script));
+                } else {
+                    v8::Local<v8::Function> function;
+                    if (!compileFunctionModule(context, &source, v8::ScriptCompiler::kNoCompileOptions).ToLocal(&function)) {
+                        std::cerr << "编译失败: " << path << std::endl;
+                        continue;
+                    }
+                    data.reset(v8::ScriptCompiler::CreateCodeCacheForFunction(function));
+                }
+            }
+            if (data) {
+                modules[index].codeCache.assign(reinterpret_cast<const char*>(data->data), data->length);
+            }
+        }
+    }
+    isolate->Dispose();
+    delete create_params.array_buffer_allocator;
+}
+
+/**
+ * 打包模块归档。从主模块开始扫描静态 require，把找到的模块连同依赖列表(和代码缓存)写入归档。
+ * 模块路径保存为相对于工作目录的路径，运行时归档挂载在运行时的工作目录上。
+ * @param options
+ * @param workDir 工作目录
+ * @return 进程退出码
+ */
+int packArchive(const Options& options, const char* workDir) {
+    std::vector<ArchiveModule> modules;
+    std::vector<uint32_t> pathIds;
+    std::vector<SourceStamp> stamps;
+    // 每个模块依赖的路径 id，全部模块找到之后再转换成模块下标
+    std::vector<std::vector<uint32_t>> dependencyPaths;
+    std::unordered_map<uint32_t, uint32_t> indices;
+
+    std::vector<uint32_t> queue;
+    queue.push_back(pathResolver.resolve(pathTable.intern(workDir), options.entry));
+    for (size_t position = 0; position < queue.size(); ++position) {
+        uint32_t pathId = queue[position];
+        if (indices.count(pathId)) {
+            continue;
+        }
+        const std::string& path = pathTable.path(pathId);
+        // 共享库只能从磁盘 dlopen，原生模块留在原来的位置
+        if (isNativeAddonPath(path)) {
+            continue;
+        }
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "找不到模块: " << path << std::endl;
+            if (position == 0) {
+                return 1;
+            }
+            continue;
+        }
+        indices[pathId] = static_cast<uint32_t>(modules.size());
+        ArchiveModule module;
+        module.path = archiveRelativePath(workDir, path);
+        module.source.assign(file.data() == nullptr ? "" : file.data(), file.size());
+        module.hash = contentHash(file.data(), file.size());
+        std::vector<std::string> specifiers;
+        scanRequires(file.data(), file.size(), specifiers);
+        std::vector<uint32_t> dependencies;
+        for (const std::string& specifier : specifiers) {
+            dependencies.push_back(pathResolver.resolve(pathTable.dirname(pathId), specifier));
+            queue.push_back(dependencies.back());
+        }
+        modules.push_back(std::move(module));
+        pathIds.push_back(pathId);
+        stamps.push_back(SourceStamp{file.mtime(), modules.back().hash});
+        dependencyPaths.push_back(std::move(dependencies));
+    }
+    for (size_t index = 0; index < modules.size(); ++index) {
+        for (uint32_t dependency : dependencyPaths[index]) {
+            auto iterator = indices.find(dependency);
+            if (iterator != indices.end()) {
+                modules[index].dependencies.push_back(iterator->second);
+            }
+        }
+    }
+    if (options.withCodeCache) {
+        createArchiveCodeCache(modules, pathIds, stamps);
+    }
+    const char* output = options.output != nullptr ? options.output : "app.cjsa";
+    if (!writeArchive(output, modules, 0, v8::ScriptCompiler::CachedDataVersionTag())) {
+        std::cerr << "写入模块归档失败: " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
 /**
  *  启动函数，参数0 为程序的名称 参数二为主模块的路径。可以是相对路径，绝对路径
+ *  --build-snapshot <entry> [-o <blob>] 构建启动快照
+ *  --snapshot <blob> <entry> 从启动快照恢复上下文之后再加载主模块
+ *  pack <entry> [-o <archive>] [--with-code-cache] 把主模块及其依赖打包成模块归档
+ *  analyze-startup <entry> 执行主模块，输出启动关键路径、各模块的包含/独占耗时，以及改成 require.async 收益最大的模块
+ *  --archive <archive> [entry] 从模块归档加载模块
+ *  --lazy <path> 惰性加载模块，第一次访问 exports 的属性时才执行。占位对象是普通对象，不能调用
+ *  --dump-graph=json|dot 退出时输出模块依赖图
+ *  --watch 监听模块文件，修改之后只重新加载该模块和依赖它的模块
+ *  --record-compile-hints <file> 预热运行，记录执行过函数的模块
+ *  --compile-hints <file> 立即编译提示中的模块
+ *  --trace-modules=<file> 把模块加载各阶段(resolve/read/compile/execute/bookkeeping)写成 Chrome trace JSON
  * @param args
  * @param argv
  * @return
  */
 int main(int args, char** argv) {
+    Options options;
     // 如果没有入口文件
-    if (argv[1] == nullptr) {
+    if (!parseOptions(args, argv, options)) {
         return 1;
     }
+    codeCache.setEnabled(options.codeCache);
+    prefetcher.setEnabled(options.prefetch);
+    loadOrder.setRecording(options.recordLoadOrder != nullptr);
     char workDirBuffer[255];
     // linux 获取工作目录
     getcwd(workDirBuffer,sizeof(workDirBuffer));
 
+    // 原生模块导出的 CFunction 快路径需要开启 fast API calls
+    v8::V8::SetFlagsFromString("--turbo-fast-api-calls");
     // 初始化v8
     v8::V8::InitializeICUDefaultLocation(argv[0]);
     v8::V8::InitializeExternalStartupData(argv[0]);
-    std::unique_ptr<v8::Platform> platform = v8::platform::NewDefaultPlatform();
-    v8::V8::InitializePlatform(platform.get());
+    std::unique_ptr<v8::TracingController> tracingController;
+    if (!options.traceModules.empty()) {
+        tracingController = moduleTrace.create(options.traceModules.c_str());
+        if (!tracingController) {
+            std::cerr << "无法写入追踪文件: " << options.traceModules << std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<v8::Platform> platform = v8::platform::NewDefaultPlatform(
+            0, v8::platform::IdleTaskSupport::kDisabled, v8::platform::InProcessStackDumping::kDisabled, std::move(tracingController));
+    // v8 通过包装的平台投递前台任务，投递时唤醒事件循环；PumpMessageLoop 仍然对默认平台调用
+    LoopPlatform loopPlatform(platform.get(), eventLoop);
+    v8::V8::InitializePlatform(&loopPlatform);
     v8::V8::Initialize();
+    moduleTrace.start();
+
+    int exitCode = 0;
+    if (options.pack) {
+        exitCode = packArchive(options, workDirBuffer);
+        moduleTrace.stop();
+        v8::V8::Dispose();
+        v8::V8::ShutdownPlatform();
+        return exitCode;
+    }
+    if (options.compileHints != nullptr) {
+        if (compileHints.load(options.compileHints, pathTable)) {
+            prefetcher.setCompileHints(&compileHints);
+        } else {
+            std::cerr << "读取编译提示失败: " << options.compileHints << std::endl;
+        }
+    }
+    std::string entry = options.entry != nullptr ? options.entry : "";
+    if (options.archive != nullptr) {
+        if (!moduleArchive.open(options.archive, workDirBuffer)) {
+            std::cerr << "读取模块归档失败: " << options.archive << std::endl;
+            return 1;
+        }
+        prefetcher.setArchive(&moduleArchive);
+        pathResolver.setArchive(&moduleArchive);
+        if (entry.empty()) {
+            entry = moduleArchive.entryPath();
+        }
+    }
+    if (!eventLoop.start()) {
+        std::cerr << "创建事件循环失败" << std::endl;
+        return 1;
+    }
+    eventLoop.setPlatform(platform.get());
+    if (options.buildSnapshot) {
+        exitCode = buildSnapshot(options, workDirBuffer);
+        moduleTrace.stop();
+        v8::V8::Dispose();
+        v8::V8::ShutdownPlatform();
+        return exitCode;
+    }
+
     v8::Isolate::CreateParams create_params;
     create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    // 快照文件直接 mmap，isolate 销毁之前不能解除映射
+    MappedFile snapshotFile;
+    v8::StartupData snapshotBlob;
+    if (options.snapshot != nullptr) {
+        if (!snapshotFile.open(options.snapshot) || snapshotFile.size() == 0) {
+            std::cerr << "读取快照失败: " << options.snapshot << std::endl;
+            return 1;
+        }
+        snapshotBlob.data = snapshotFile.data();
+        snapshotBlob.raw_size = static_cast<int>(snapshotFile.size());
+        create_params.snapshot_blob = &snapshotBlob;
+        create_params.external_references = externalReferences;
+    }
     v8::Isolate* isolate = v8::Isolate::New(create_params);
 
     {
@@ -291,38 +1978,91 @@ int main(int args, char** argv) {
 
         // 设置微任务队列策略 显示调用
         isolate->SetMicrotasksPolicy(v8::MicrotasksPolicy::kExplicit);
-        v8::Local<v8::Context> context = v8::Context::New(isolate);
+        // 流式编译回调必须在创建上下文之前设置
+        wasmModules.attach(isolate);
+        v8::Local<v8::Context> context;
+        if (options.snapshot != nullptr) {
+            context = v8::Context::FromSnapshot(isolate, kSnapshotContextIndex,
+                                                v8::DeserializeInternalFieldsCallback(ModuleRegistry::deserializeModuleId)).ToLocalChecked();
+        } else {
+            context = v8::Context::New(isolate);
+        }
         v8::Context::Scope context_scope(context);
 
         // 初始化当前模块ID和缓存模块
-        currentModuleId.Reset(isolate, v8::String::NewFromUtf8(isolate, workDirBuffer).ToLocalChecked());
-        cache.Reset(isolate, v8::Object::New(isolate));
-
-        // 设置全局函数 define
-        context->Global()->Set(context, v8::String::NewFromUtf8Literal(isolate, "define"), v8::Function::New(context, define).ToLocalChecked()).FromJust();
-        // 设置全局函数用于打印结果
-        context->Global()->Set(context, v8::String::NewFromUtf8Literal(isolate, "print"),
-                               v8::Function::New(context, [](const v8::FunctionCallbackInfo <v8::Value> &info) -> void {
-                                   v8::Isolate *isolate = info.GetIsolate();
-                                   v8::Local<v8::Context> context = isolate->GetCurrentContext();
-                                   // 如果是普通的对象，直接转成JSON字符串。如果是其他类型强制转换成字符串输出。
-                                   if (!info[0]->IsNull() && info[0]->IsObject() && !info[0]->IsFunction()) {
-                                       std::cout << *v8::String::Utf8Value(isolate, v8::JSON::Stringify(context, info[0]).ToLocalChecked()) << std::endl;
-                                   } else {
-                                       std::cout << *v8::String::Utf8Value(isolate, info[0].As<v8::String>()) << std::endl;
-                                   }
-                               }).ToLocalChecked()).FromJust();
-        // 创建require 函数
-        v8::Local<v8::Function> requireFun = v8::Function::New(context, require).ToLocalChecked();
-        v8::Local<v8::Value> args[] = { v8::String::NewFromUtf8(isolate, argv[1]).ToLocalChecked() };
-        // 加载主模块
-        requireFun->Call(context, context->Global(), 1, args).ToLocalChecked();
-        //情况微任务队列。
-        isolate->PerformMicrotaskCheckpoint();
+        moduleRegistry.attach(isolate);
+        lazyModules.attach(isolate);
+        dependencyGraph.attach(isolate);
+        dependencyGraph.installView(isolate, moduleRegistry.moduleTemplate(isolate));
+        // import() 和 import.meta
+        isolate->SetHostImportModuleDynamicallyCallback(importModuleDynamically);
+        isolate->SetHostInitializeImportMetaObjectCallback(initializeImportMeta);
+        enterWorkDir(workDirBuffer);
+        for (const char* lazy : options.lazy) {
+            lazyModules.add(pathResolver.resolve(workDirId, lazy));
+        }
+        // 快照中的模块持有的 require 对象是快照里模板的实例，需要继续使用同一个模板
+        v8::Local<v8::FunctionTemplate> restoredRequireTemplate;
+        if (options.snapshot != nullptr &&
+            isolate->GetDataFromSnapshotOnce<v8::FunctionTemplate>(kSnapshotRequireTemplateIndex).ToLocal(&restoredRequireTemplate)) {
+            requireTemplate.Reset(isolate, restoredRequireTemplate);
+        } else {
+            requireTemplate.Reset(isolate, newRequireTemplate(isolate));
+        }
+        if (options.snapshot != nullptr) {
+            // define、print 已经在快照的全局对象上，只需要用快照中的模块重建注册表
+            importModules(isolate, context, context->GetDataFromSnapshotOnce<v8::Array>(kSnapshotModulesIndex).ToLocalChecked());
+            dependencyGraph.importGraph(isolate, context, context->GetDataFromSnapshotOnce<v8::Array>(kSnapshotGraphIndex).ToLocalChecked());
+            lazyModules.importState(isolate, context->GetDataFromSnapshotOnce<v8::Object>(kSnapshotLazyIndex).ToLocalChecked());
+        } else {
+            installGlobals(isolate, context);
+        }
+        requireCache.Reset(isolate, moduleRegistry.newCacheView(isolate, context));
+        if (options.replayLoadOrder != nullptr) {
+            replayLoadOrder(isolate, options.replayLoadOrder);
+        }
+        if (options.watch && !moduleWatcher.start()) {
+            std::cerr << "创建 inotify 失败" << std::endl;
+        }
+        if (options.recordCompileHints != nullptr) {
+            compileHints.startRecording(isolate);
+        }
+        runEntry(isolate, context, entry.c_str(), options.analyzeStartup);
+        if (moduleWatcher.started()) {
+            watchModules(isolate, context);
+            moduleWatcher.stop();
+        }
+        if (options.recordCompileHints != nullptr && !finishCompileHints(isolate, options.recordCompileHints)) {
+            std::cerr << "写入编译提示失败: " << options.recordCompileHints << std::endl;
+            exitCode = 1;
+        }
+        wasmModules.saveCaches();
+        prefetcher.shutdown();
+    }
+    if (options.recordLoadOrder != nullptr && !loadOrder.save(options.recordLoadOrder, pathTable)) {
+        std::cerr << "写入加载顺序失败: " << options.recordLoadOrder << std::endl;
+        exitCode = 1;
+    }
+    if (options.dumpGraph == "json") {
+        dependencyGraph.writeJson(std::cerr);
+    } else if (options.dumpGraph == "dot") {
+        dependencyGraph.writeDot(std::cerr);
     }
+    if (options.codeCacheStats) {
+        const CodeCache::Stats& stats = codeCache.stats();
+        std::cerr << "code cache: hits=" << stats.hits << " misses=" << stats.misses
+                  << " rejected=" << stats.rejected << " writes=" << stats.writes << std::endl;
+    }
+    requireTemplate.Reset();
+    requireCache.Reset();
+    esModules.clear();
+    wasmModules.clear();
+    moduleRegistry.clear();
+    lazyModules.reset();
     isolate->Dispose();
+    moduleTrace.stop();
     v8::V8::Dispose();
     v8::V8::ShutdownPlatform();
     delete create_params.array_buffer_allocator;
-    return 0;
-}
\ No newline at end of file
+    return exitCode;
+}
@@ -0,0 +1,44 @@
+#ifndef COMMONJS_SERVER_MAPPED_FILE_H
+#define COMMONJS_SERVER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * 只读 mmap 映射的文件，析构时解除映射
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * 映射整个文件。空文件映射成功，但 data() 为 nullptr
+     * @param path 文件路径
+     * @return 是否成功
+     */
+    bool open(const std::string& path);
+
+    /**
+     * 解除映射
+     */
+    void close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    // 文件最后修改时间(纳秒)
+    int64_t mtime() const { return mtime_; }
+    bool isOpen() const { return opened_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    int64_t mtime_ = 0;
+    bool opened_ = false;
+};
+
+#endif //COMMONJS_SERVER_MAPPED_FILE_H
@@ -0,0 +1,147 @@
+#include "module_archive.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// 归档魔数 "CJSA"
+const uint32_t kArchiveMagic = 0x41534a43;
+const uint32_t kArchiveVersion = 1;
+
+/**
+ * 在缓冲区末尾追加数据，返回数据的偏移。alignment 为数据的对齐字节数
+ */
+uint64_t append(std::string& buffer, const void* data, size_t length, size_t alignment = 1) {
+    size_t padding = (alignment - buffer.size() % alignment) % alignment;
+    buffer.append(padding, '\0');
+    uint64_t offset = buffer.size();
+    buffer.append(static_cast<const char*>(data), length);
+    return offset;
+}
+
+}
+
+std::string archiveRelativePath(const std::string& root, const std::string& path) {
+    if (path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/') {
+        return path.substr(root.size() + 1);
+    }
+    return path;
+}
+
+bool writeArchive(const std::string& file, const std::vector<ArchiveModule>& modules, uint32_t entry, uint32_t versionTag) {
+    uint32_t count = static_cast<uint32_t>(modules.size());
+    // order 为排序后的模块下标，rank 为原下标对应的排序位置
+    std::vector<uint32_t> order(count);
+    for (uint32_t index = 0; index < count; ++index) {
+        order[index] = index;
+    }
+    std::sort(order.begin(), order.end(), [&modules](uint32_t left, uint32_t right) {
+        return modules[left].path < modules[right].path;
+    });
+    std::vector<uint32_t> rank(count);
+    for (uint32_t index = 0; index < count; ++index) {
+        rank[order[index]] = index;
+    }
+
+    std::string buffer(sizeof(ArchiveHeader) + sizeof(ArchiveEntry) * count, '\0');
+    std::vector<ArchiveEntry> entries(count);
+    for (uint32_t index = 0; index < count; ++index) {
+        const ArchiveModule& module = modules[order[index]];
+        ArchiveEntry& archiveEntry = entries[index];
+        memset(&archiveEntry, 0, sizeof(archiveEntry));
+        archiveEntry.pathOffset = append(buffer, module.path.data(), module.path.size());
+        archiveEntry.pathLength = static_cast<uint32_t>(module.path.size());
+        archiveEntry.sourceOffset = append(buffer, module.source.data(), module.source.size());
+        archiveEntry.sourceLength = static_cast<uint32_t>(module.source.size());
+        archiveEntry.hash = module.hash;
+        std::vector<uint32_t> dependencies;
+        for (uint32_t dependency : module.dependencies) {
+            dependencies.push_back(rank[dependency]);
+        }
+        archiveEntry.depsOffset = append(buffer, dependencies.data(), dependencies.size() * sizeof(uint32_t), sizeof(uint32_t));
+        archiveEntry.depsCount = static_cast<uint32_t>(dependencies.size());
+        if (!module.codeCache.empty()) {
+            // v8 要求代码缓存按指针大小对齐，否则会先拷贝一份
+            archiveEntry.cacheOffset = append(buffer, module.codeCache.data(), module.codeCache.size(), sizeof(uint64_t));
+            archiveEntry.cacheLength = static_cast<uint32_t>(module.codeCache.size());
+        }
+    }
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kArchiveMagic;
+    header.version = kArchiveVersion;
+    header.count = count;
+    header.versionTag = versionTag;
+    header.indexOffset = sizeof(ArchiveHeader);
+    header.entryOffset = entries[rank[entry]].pathOffset;
+    header.entryLength = entries[rank[entry]].pathLength;
+    memcpy(&buffer[0], &header, sizeof(header));
+    if (count > 0) {
+        memcpy(&buffer[sizeof(ArchiveHeader)], entries.data(), sizeof(ArchiveEntry) * count);
+    }
+
+    std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.close();
+    return static_cast<bool>(out);
+}
+
+bool ModuleArchive::open(const std::string& file, const std::string& root) {
+    if (!file_.open(file) || file_.size() < sizeof(ArchiveHeader)) {
+        return false;
+    }
+    const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(file_.data());
+    if (header->magic != kArchiveMagic || header->version != kArchiveVersion ||
+        header->indexOffset + sizeof(ArchiveEntry) * header->count > file_.size()) {
+        file_.close();
+        return false;
+    }
+    header_ = header;
+    entries_ = reinterpret_cast<const ArchiveEntry*>(file_.data() + header->indexOffset);
+    root_ = root;
+    return true;
+}
+
+int ModuleArchive::find(const std::string& path) const {
+    if (header_ == nullptr) {
+        return -1;
+    }
+    std::string relative = archiveRelativePath(root_, path);
+    // 索引按路径排序，二分查找
+    uint32_t low = 0;
+    uint32_t high = header_->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        const ArchiveEntry& archiveEntry = entries_[middle];
+        size_t length = std::min<size_t>(archiveEntry.pathLength, relative.size());
+        int result = memcmp(file_.data() + archiveEntry.pathOffset, relative.data(), length);
+        if (result == 0) {
+            result = archiveEntry.pathLength < relative.size() ? -1 : (archiveEntry.pathLength > relative.size() ? 1 : 0);
+        }
+        if (result == 0) {
+            return static_cast<int>(middle);
+        }
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return -1;
+}
+
+std::string ModuleArchive::toAbsolute(const char* path, size_t length) const {
+    if (length > 0 && path[0] == '/') {
+        return std::string(path, length);
+    }
+    return root_ + "/" + std::string(path, length);
+}
+
+std::string ModuleArchive::absolutePath(uint32_t index) const {
+    return toAbsolute(file_.data() + entries_[index].pathOffset, entries_[index].pathLength);
+}
+
+std::string ModuleArchive::entryPath() const {
+    return toAbsolute(file_.data() + header_->entryOffset, header_->entryLength);
+}
@@ -0,0 +1,140 @@
+#ifndef COMMONJS_SERVER_MODULE_ARCHIVE_H
+#define COMMONJS_SERVER_MODULE_ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+/**
+ * 模块归档文件(.cjsa)的文件头。
+ * 文件布局：文件头 | 按路径排序的索引 | 路径、源码、依赖列表、代码缓存数据
+ */
+struct ArchiveHeader {
+    // 魔数 "CJSA"
+    uint32_t magic;
+    uint32_t version;
+    // 模块数量
+    uint32_t count;
+    // 生成代码缓存时的 ScriptCompiler::CachedDataVersionTag
+    uint32_t versionTag;
+    // 索引的偏移
+    uint64_t indexOffset;
+    // 主模块路径的偏移和长度
+    uint64_t entryOffset;
+    uint32_t entryLength;
+    uint32_t reserved;
+};
+
+/**
+ * 归档索引中的一个模块。路径是相对于归档根目录的路径，根目录以外的模块保存绝对路径。
+ */
+struct ArchiveEntry {
+    uint64_t pathOffset;
+    uint64_t sourceOffset;
+    // 依赖列表，每一项为依赖模块在索引中的下标(uint32_t)
+    uint64_t depsOffset;
+    uint64_t cacheOffset;
+    // 源码内容 hash
+    uint64_t hash;
+    uint32_t pathLength;
+    uint32_t sourceLength;
+    uint32_t depsCount;
+    // 没有代码缓存时为 0
+    uint32_t cacheLength;
+};
+
+/**
+ * 打包时的模块数据
+ */
+struct ArchiveModule {
+    // 相对于归档根目录的路径
+    std::string path;
+    std::string source;
+    uint64_t hash = 0;
+    // 依赖模块在模块列表中的下标
+    std::vector<uint32_t> dependencies;
+    // 代码缓存，可以为空
+    std::string codeCache;
+};
+
+/**
+ * 把模块写入归档文件，写入时按路径排序
+ * @param file 归档文件路径
+ * @param modules 模块列表
+ * @param entry 主模块在模块列表中的下标
+ * @param versionTag 代码缓存的版本标记
+ * @return 是否成功
+ */
+bool writeArchive(const std::string& file, const std::vector<ArchiveModule>& modules, uint32_t entry, uint32_t versionTag);
+
+/**
+ * 计算绝对路径相对于根目录的路径，根目录以外的路径原样返回
+ * @param root
+ * @param path
+ * @return
+ */
+std::string archiveRelativePath(const std::string& root, const std::string& path);
+
+/**
+ * 只读的模块归档。整个文件通过 mmap 映射，require 在索引中二分查找模块，不访问文件系统。
+ * 归档挂载在根目录(工作目录)上，模块的绝对路径为 根目录 + 相对路径。
+ */
+class ModuleArchive {
+public:
+    /**
+     * 打开归档
+     * @param file 归档文件路径
+     * @param root 挂载的根目录
+     * @return 是否成功
+     */
+    bool open(const std::string& file, const std::string& root);
+
+    bool isOpen() const { return header_ != nullptr; }
+
+    uint32_t size() const { return header_ == nullptr ? 0 : header_->count; }
+
+    uint32_t versionTag() const { return header_->versionTag; }
+
+    /**
+     * 根据绝对路径查找模块
+     * @param path 模块绝对路径
+     * @return 模块在索引中的下标，不存在时返回 -1
+     */
+    int find(const std::string& path) const;
+
+    const ArchiveEntry& entry(uint32_t index) const { return entries_[index]; }
+
+    const char* source(uint32_t index) const { return file_.data() + entries_[index].sourceOffset; }
+
+    const uint8_t* codeCache(uint32_t index) const {
+        return reinterpret_cast<const uint8_t*>(file_.data() + entries_[index].cacheOffset);
+    }
+
+    const uint32_t* dependencies(uint32_t index) const {
+        return reinterpret_cast<const uint32_t*>(file_.data() + entries_[index].depsOffset);
+    }
+
+    /**
+     * 模块的绝对路径
+     * @param index
+     * @return
+     */
+    std::string absolutePath(uint32_t index) const;
+
+    /**
+     * 主模块的绝对路径
+     * @return
+     */
+    std::string entryPath() const;
+
+private:
+    std::string toAbsolute(const char* path, size_t length) const;
+
+    MappedFile file_;
+    std::string root_;
+    const ArchiveHeader* header_ = nullptr;
+    const ArchiveEntry* entries_ = nullptr;
+};
+
+#endif //COMMONJS_SERVER_MODULE_ARCHIVE_H
@@ -0,0 +1,269 @@
+#include "module_prefetcher.h"
+#include <cstring>
+#include "require_scanner.h"
+
+namespace {
+
+/**
+ * 是否可能是 define 模块。JSON、wasm、原生扩展和 ES 模块不走脚本编译，不需要流式编译
+ * @param path
+ * @return
+ */
+bool maybeScript(const std::string& path) {
+    return !has_suffix(path, ".json") && !has_suffix(path, ".wasm") && !has_suffix(path, ".node") && !has_suffix(path, ".mjs");
+}
+
+}
+
+/**
+ * 流式编译的数据源。源码已经在内存里(归档或者预取时映射的文件)，整个文件作为一块交给 v8。
+ * 数据源只在 StreamedSource 存活期间使用，源码的所有者(归档或者 PrefetchedModule)活得更久
+ */
+class ModulePrefetcher::SourceStream : public v8::ScriptCompiler::ExternalSourceStream {
+public:
+    SourceStream(const char* source, size_t length) : source_(source), length_(length) {}
+
+    size_t GetMoreData(const uint8_t** src) override {
+        if (consumed_ || length_ == 0) {
+            return 0;
+        }
+        consumed_ = true;
+        // v8 接管数据块的所有权
+        uint8_t* chunk = new uint8_t[length_];
+        memcpy(chunk, source_, length_);
+        *src = chunk;
+        return length_;
+    }
+
+private:
+    const char* source_;
+    size_t length_;
+    bool consumed_ = false;
+};
+
+ModulePrefetcher::~ModulePrefetcher() {
+    shutdown();
+}
+
+bool ModulePrefetcher::startStreaming(v8::Isolate* isolate, PrefetchedModule* module, const char* source, size_t length) {
+    module->streamed.reset(new v8::ScriptCompiler::StreamedSource(
+            std::unique_ptr<v8::ScriptCompiler::ExternalSourceStream>(new SourceStream(source, length)),
+            v8::ScriptCompiler::StreamedSource::UTF8));
+    module->task.reset(v8::ScriptCompiler::StartStreaming(isolate, module->streamed.get()));
+    if (!module->task) {
+        module->streamed.reset();
+        return false;
+    }
+    return true;
+}
+
+bool ModulePrefetcher::readSource(PrefetchedModule* module) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(module->path)) {
+        return false;
+    }
+    module->stamp.mtime = file->mtime();
+    module->stamp.hash = contentHash(file->data(), file->size());
+    scanRequires(file->data(), file->size(), module->specifiers);
+    module->file = std::move(file);
+    return true;
+}
+
+void ModulePrefetcher::prefetch(v8::Isolate* isolate, uint32_t pathId) {
+    if (enabled_) {
+        start(isolate, pathId);
+    }
+}
+
+void ModulePrefetcher::load(v8::Isolate* isolate, uint32_t pathId, std::function<void()> done) {
+    start(isolate, pathId);
+    auto iterator = entries_.find(pathId);
+    if (iterator != entries_.end()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!iterator->second->done) {
+            iterator->second->listeners.push_back(std::move(done));
+            return;
+        }
+    }
+    done();
+}
+
+void ModulePrefetcher::start(v8::Isolate* isolate, uint32_t pathId) {
+    if (registry_.find(pathId) != kInvalidModuleId) {
+        return;
+    }
+    if (pathId >= requested_.size()) {
+        requested_.resize(pathId + 1, false);
+    }
+    if (requested_[pathId]) {
+        return;
+    }
+    requested_[pathId] = true;
+    if (!pool_) {
+        pool_.reset(new ThreadPool());
+    }
+
+    std::shared_ptr<PrefetchedModule> module = std::make_shared<PrefetchedModule>();
+    module->pathId = pathId;
+    module->path = resolver_.paths().path(pathId);
+    module->archiveIndex = archive_ != nullptr ? archive_->find(module->path) : -1;
+    // 热模块需要立即编译，不能使用惰性的流式编译
+    bool eager = hints_ != nullptr && hints_->isHot(pathId);
+    if (module->archiveIndex >= 0) {
+        uint32_t archiveIndex = static_cast<uint32_t>(module->archiveIndex);
+        const ArchiveEntry& entry = archive_->entry(archiveIndex);
+        module->stamp.hash = entry.hash;
+        archivedDependencies(archiveIndex, module->dependencies);
+        // 源码已经在内存里，有代码缓存时主线程直接反序列化；没有代码缓存的 define 模块在后台流式编译
+        const char* source = archive_->source(archiveIndex);
+        if (eager || (entry.cacheLength > 0 && archive_->versionTag() == v8::ScriptCompiler::CachedDataVersionTag()) ||
+            !isDefineModule(source, entry.sourceLength) || !startStreaming(isolate, module.get(), source, entry.sourceLength)) {
+            prefetchAll(isolate, module->dependencies);
+            return;
+        }
+    } else if (!eager && maybeScript(module->path) && !codeCache_.exists(module->path)) {
+        // 有代码缓存时反序列化比流式编译更快，只需要在后台读取缓存文件；
+        // 没有时先在后台读取源码，是 define 模块再由 pump 开始流式编译
+        module->streamPending = true;
+    }
+    entries_[pathId] = module;
+    post(module);
+}
+
+void ModulePrefetcher::post(const std::shared_ptr<PrefetchedModule>& module) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_++;
+    }
+    pool_->post([this, module]() {
+        if (module->task) {
+            module->task->Run();
+        } else if (readSource(module.get())) {
+            if (module->streamPending) {
+                // 普通 CommonJS 模块在主线程编译成函数，流式编译的脚本用不上
+                module->streamPending = module->file->size() > 0 && isDefineModule(module->file->data(), module->file->size());
+            } else {
+                module->cachedData.reset(codeCache_.read(module->path, module->stamp, module->lookup));
+            }
+        } else {
+            module->streamPending = false;
+        }
+        complete(module);
+    });
+}
+
+void ModulePrefetcher::complete(const std::shared_ptr<PrefetchedModule>& module) {
+    std::vector<std::function<void()>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        module->done = true;
+        listeners.swap(module->listeners);
+        completed_.push_back(module);
+    }
+    for (const std::function<void()>& listener : listeners) {
+        listener();
+    }
+    {
+        // 监听者全部通知之后才算结束，shutdown 返回之后不会再有回调
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+    }
+    condition_.notify_all();
+}
+
+void ModulePrefetcher::prefetchAll(v8::Isolate* isolate, uint32_t dirId, const std::vector<std::string>& specifiers) {
+    for (const std::string& specifier : specifiers) {
+        prefetch(isolate, resolver_.resolve(dirId, specifier));
+    }
+}
+
+void ModulePrefetcher::prefetchAll(v8::Isolate* isolate, const std::vector<uint32_t>& pathIds) {
+    for (uint32_t pathId : pathIds) {
+        prefetch(isolate, pathId);
+    }
+}
+
+void ModulePrefetcher::archivedDependencies(uint32_t archiveIndex, std::vector<uint32_t>& dependencies) {
+    const uint32_t* indices = archive_->dependencies(archiveIndex);
+    for (uint32_t index = 0; index < archive_->entry(archiveIndex).depsCount; ++index) {
+        dependencies.push_back(resolver_.paths().intern(archive_->absolutePath(indices[index])));
+    }
+}
+
+void ModulePrefetcher::prefetchArchived(v8::Isolate* isolate, uint32_t archiveIndex) {
+    if (!enabled_) {
+        return;
+    }
+    std::vector<uint32_t> dependencies;
+    archivedDependencies(archiveIndex, dependencies);
+    prefetchAll(isolate, dependencies);
+}
+
+void ModulePrefetcher::scan(v8::Isolate* isolate, uint32_t dirId, const char* source, size_t length) {
+    if (!enabled_) {
+        return;
+    }
+    std::vector<std::string> specifiers;
+    scanRequires(source, length, specifiers);
+    prefetchAll(isolate, dirId, specifiers);
+}
+
+void ModulePrefetcher::pump(v8::Isolate* isolate) {
+    std::vector<std::shared_ptr<PrefetchedModule>> completed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completed.swap(completed_);
+    }
+    for (const std::shared_ptr<PrefetchedModule>& module : completed) {
+        if (module->streamPending) {
+            module->streamPending = false;
+            // 已经被取走或者丢弃的模块不再编译
+            auto iterator = entries_.find(module->pathId);
+            if (iterator != entries_.end() && iterator->second == module &&
+                startStreaming(isolate, module.get(), module->file->data(), module->file->size())) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    module->done = false;
+                }
+                post(module);
+            }
+        }
+        prefetchAll(isolate, resolver_.paths().dirname(module->pathId), module->specifiers);
+        prefetchAll(isolate, module->dependencies);
+    }
+}
+
+std::shared_ptr<PrefetchedModule> ModulePrefetcher::take(v8::Isolate* isolate, uint32_t pathId) {
+    auto iterator = entries_.find(pathId);
+    if (iterator == entries_.end()) {
+        return nullptr;
+    }
+    std::shared_ptr<PrefetchedModule> module = iterator->second;
+    entries_.erase(iterator);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [&module] { return module->done; });
+    }
+    // 保证该模块的依赖已经开始预取
+    pump(isolate);
+    return module;
+}
+
+void ModulePrefetcher::forget(uint32_t pathId) {
+    if (pathId < requested_.size()) {
+        requested_[pathId] = false;
+    }
+    // 还没有被取走的结果映射着旧文件，文件被原地改写之后不能再读；后台任务自己持有一份，可以直接丢弃
+    entries_.erase(pathId);
+}
+
+void ModulePrefetcher::shutdown() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return running_ == 0; });
+        completed_.clear();
+    }
+    entries_.clear();
+    requested_.clear();
+    pool_.reset();
+}
@@ -0,0 +1,216 @@
+#ifndef COMMONJS_SERVER_MODULE_PREFETCHER_H
+#define COMMONJS_SERVER_MODULE_PREFETCHER_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "v8.h"
+#include "code_cache.h"
+#include "compile_hints.h"
+#include "mapped_file.h"
+#include "module_archive.h"
+#include "module_registry.h"
+#include "path_resolver.h"
+#include "thread_pool.h"
+
+/**
+ * 后台预取的模块。done 之前只有后台线程可以访问下面的字段。
+ */
+struct PrefetchedModule {
+    uint32_t pathId = kInvalidPathId;
+    std::string path;
+    // 映射的源码文件，文件不存在时为 nullptr
+    std::unique_ptr<MappedFile> file;
+    // 模块在归档中的下标，不在归档中时为 -1。归档中的模块源码直接在内存里，不需要读取
+    int archiveIndex = -1;
+    SourceStamp stamp;
+    // 存在代码缓存时，后台读取的缓存数据
+    std::unique_ptr<v8::ScriptCompiler::CachedData> cachedData;
+    CodeCache::Lookup lookup = CodeCache::Lookup::kMiss;
+    // 不存在代码缓存的 define 模块，读取之后由主线程开始流式编译
+    bool streamPending = false;
+    // 不存在代码缓存时，后台流式编译
+    std::unique_ptr<v8::ScriptCompiler::StreamedSource> streamed;
+    std::unique_ptr<v8::ScriptCompiler::ScriptStreamingTask> task;
+    // 源码中静态 require 的模块标识
+    std::vector<std::string> specifiers;
+    // 已经解析好的依赖(来自归档中的依赖列表)
+    std::vector<uint32_t> dependencies;
+    bool done = false;
+    // 预取完成时在后台线程调用，受预取器的锁保护
+    std::vector<std::function<void()>> listeners;
+};
+
+/**
+ * 模块预取器。模块源码读取之后立即扫描其中静态的 require('...')，
+ * 在线程池中读取这些依赖，有代码缓存的读取缓存，没有代码缓存的 define 模块通过 ScriptCompiler::StartStreaming 在后台编译。
+ * 流式编译的结果是脚本，只有 define 模块用得上；文件要先读到才知道是不是 define 模块，
+ * 所以文件模块在后台读取之后由主线程的 pump 开始流式编译，其他模块只在后台读取源码。
+ * 模块的执行顺序不变，require 执行到某个依赖时直接使用预取的结果。
+ * 路径解析依赖主线程的解析缓存，所以在主线程进行；后台线程只做文件读取、扫描和编译。
+ */
+class ModulePrefetcher {
+public:
+    ModulePrefetcher(PathResolver& resolver, ModuleRegistry& registry, CodeCache& codeCache)
+            : resolver_(resolver), registry_(registry), codeCache_(codeCache) {}
+    ~ModulePrefetcher();
+
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+
+    /**
+     * 设置模块归档，归档中的模块使用归档里的依赖列表和代码缓存
+     * @param archive
+     */
+    void setArchive(const ModuleArchive* archive) { archive_ = archive; }
+
+    /**
+     * 设置编译提示。流式编译只能惰性编译，热模块改为在后台读取源码，由主线程立即编译
+     * @param hints
+     */
+    void setCompileHints(const CompileHints* hints) { hints_ = hints; }
+
+    /**
+     * 预取模块。已经注册或者已经预取过的模块会被忽略
+     * @param isolate
+     * @param pathId 模块绝对路径 id
+     */
+    void prefetch(v8::Isolate* isolate, uint32_t pathId);
+
+    /**
+     * 在后台读取(和编译)模块，完成之后调用 done。不受 --no-prefetch 影响，用于 require.async。
+     * done 可能在后台线程调用；模块已经注册、已经预取完成或者已经被取走时在当前线程立即调用
+     * @param isolate
+     * @param pathId 模块绝对路径 id
+     * @param done
+     */
+    void load(v8::Isolate* isolate, uint32_t pathId, std::function<void()> done);
+
+    /**
+     * 解析并预取一组模块标识
+     * @param isolate
+     * @param dirId 所在模块的目录 id
+     * @param specifiers
+     */
+    void prefetchAll(v8::Isolate* isolate, uint32_t dirId, const std::vector<std::string>& specifiers);
+
+    /**
+     * 预取一组已经解析好的模块
+     * @param isolate
+     * @param pathIds
+     */
+    void prefetchAll(v8::Isolate* isolate, const std::vector<uint32_t>& pathIds);
+
+    /**
+     * 预取归档中模块的依赖
+     * @param isolate
+     * @param archiveIndex 模块在归档中的下标
+     */
+    void prefetchArchived(v8::Isolate* isolate, uint32_t archiveIndex);
+
+    /**
+     * 扫描同步读取的模块源码，预取其中的依赖
+     * @param isolate
+     * @param dirId 模块所在目录 id
+     * @param source
+     * @param length
+     */
+    void scan(v8::Isolate* isolate, uint32_t dirId, const char* source, size_t length);
+
+    /**
+     * 取出模块的预取结果。正在预取时等待后台完成
+     * @param isolate
+     * @param pathId
+     * @return 没有预取过时返回 nullptr
+     */
+    std::shared_ptr<PrefetchedModule> take(v8::Isolate* isolate, uint32_t pathId);
+
+    /**
+     * 处理后台已经完成的预取，继续预取它们的依赖，读取到的 define 模块开始流式编译。在主线程调用
+     * @param isolate
+     */
+    void pump(v8::Isolate* isolate);
+
+    /**
+     * 丢弃还没有被取走的预取结果，并允许模块被再次预取，用于模块被移出注册表之后
+     * @param pathId
+     */
+    void forget(uint32_t pathId);
+
+    /**
+     * 等待所有后台任务结束并丢弃未使用的预取结果。isolate 销毁之前必须调用
+     */
+    void shutdown();
+
+private:
+    /**
+     * 开始预取模块，不检查是否启用
+     * @param isolate
+     * @param pathId
+     */
+    void start(v8::Isolate* isolate, uint32_t pathId);
+
+    /**
+     * 在后台线程读取源码并扫描依赖
+     * @param module
+     * @return 文件是否存在
+     */
+    static bool readSource(PrefetchedModule* module);
+
+    /**
+     * 开始流式编译模块，源码已经在内存里
+     * @param isolate
+     * @param module
+     * @param source
+     * @param length
+     * @return 是否开始
+     */
+    static bool startStreaming(v8::Isolate* isolate, PrefetchedModule* module, const char* source, size_t length);
+
+    /**
+     * 在线程池中执行预取任务，完成之后调用 complete
+     * @param module
+     */
+    void post(const std::shared_ptr<PrefetchedModule>& module);
+
+    /**
+     * 归档中模块的依赖
+     * @param archiveIndex
+     * @param dependencies 输出依赖模块的路径 id
+     */
+    void archivedDependencies(uint32_t archiveIndex, std::vector<uint32_t>& dependencies);
+
+    /**
+     * 后台线程中完成预取
+     * @param module
+     */
+    void complete(const std::shared_ptr<PrefetchedModule>& module);
+
+    class SourceStream;
+
+    bool enabled_ = true;
+    PathResolver& resolver_;
+    ModuleRegistry& registry_;
+    CodeCache& codeCache_;
+    const ModuleArchive* archive_ = nullptr;
+    const CompileHints* hints_ = nullptr;
+    // 第一次预取时才创建线程
+    std::unique_ptr<ThreadPool> pool_;
+    // 主线程持有的预取结果
+    std::unordered_map<uint32_t, std::shared_ptr<PrefetchedModule>> entries_;
+    // 已经预取过的路径 id
+    std::vector<bool> requested_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    // 后台完成、主线程还没有处理依赖的预取
+    std::vector<std::shared_ptr<PrefetchedModule>> completed_;
+    // 正在后台执行的任务数
+    size_t running_ = 0;
+};
+
+#endif //COMMONJS_SERVER_MODULE_PREFETCHER_H
@@ -0,0 +1,145 @@
+#include "module_registry.h"
+#include <cstring>
+
+void ModuleRegistry::attach(v8::Isolate* isolate) {
+    isolate->SetData(kModuleRegistrySlot, this);
+    uriKey_.Set(isolate, v8::String::NewFromUtf8Literal(isolate, "uri", v8::NewStringType::kInternalized));
+    exportsKey_.Set(isolate, v8::String::NewFromUtf8Literal(isolate, "exports", v8::NewStringType::kInternalized));
+    dependenciesKey_.Set(isolate, v8::String::NewFromUtf8Literal(isolate, "dependencies", v8::NewStringType::kInternalized));
+}
+
+ModuleRegistry* ModuleRegistry::from(v8::Isolate* isolate) {
+    return static_cast<ModuleRegistry*>(isolate->GetData(kModuleRegistrySlot));
+}
+
+uint32_t ModuleRegistry::add(v8::Isolate* isolate, uint32_t pathId, v8::Local<v8::Object> module) {
+    if (pathId >= byPath_.size()) {
+        byPath_.resize(pathId + 1, kInvalidModuleId);
+    }
+    uint32_t moduleId = byPath_[pathId];
+    if (moduleId != kInvalidModuleId) {
+        modules_[moduleId].Reset(isolate, module);
+        return moduleId;
+    }
+    moduleId = static_cast<uint32_t>(modules_.size());
+    byPath_[pathId] = moduleId;
+    modules_.emplace_back(isolate, module);
+    pathIds_.push_back(pathId);
+    return moduleId;
+}
+
+v8::Local<v8::ObjectTemplate> ModuleRegistry::moduleTemplate(v8::Isolate* isolate) {
+    if (moduleTemplate_.IsEmpty()) {
+        v8::Local<v8::ObjectTemplate> objectTemplate = v8::ObjectTemplate::New(isolate);
+        objectTemplate->SetInternalFieldCount(kModuleFieldCount);
+        // 属性先在模板上占位，实例化之后的赋值不会改变隐藏类
+        objectTemplate->Set(uriKey(isolate), v8::String::Empty(isolate));
+        objectTemplate->Set(exportsKey(isolate), v8::Undefined(isolate));
+        moduleTemplate_.Reset(isolate, objectTemplate);
+    }
+    return moduleTemplate_.Get(isolate);
+}
+
+v8::Local<v8::Object> ModuleRegistry::create(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t pathId,
+                                             v8::Local<v8::Value> exports, uint32_t& moduleId) {
+    v8::EscapableHandleScope handleScope(isolate);
+    const std::string& path = paths_.path(pathId);
+    v8::Local<v8::Object> module = moduleTemplate(isolate)->NewInstance(context).ToLocalChecked();
+    module->Set(context, uriKey(isolate), v8::String::NewFromUtf8(isolate, path.data(), v8::NewStringType::kNormal,
+                                                                  static_cast<int>(path.size())).ToLocalChecked()).FromJust();
+    module->Set(context, exportsKey(isolate), exports).FromJust();
+    moduleId = add(isolate, pathId, module);
+    module->SetInternalField(kModuleIdField, v8::Integer::NewFromUnsigned(isolate, moduleId));
+    return handleScope.Escape(module);
+}
+
+void ModuleRegistry::clear() {
+    byPath_.clear();
+    modules_.clear();
+    pathIds_.clear();
+    cacheTemplate_.Reset();
+    moduleTemplate_.Reset();
+}
+
+v8::StartupData ModuleRegistry::serializeModuleId(v8::Local<v8::Object> holder, int index, void*) {
+    v8::Local<v8::Value> value = holder->GetInternalField(index);
+    if (!value->IsUint32() || value.As<v8::Uint32>()->Value() == 0) {
+        return { nullptr, 0 };
+    }
+    uint32_t moduleId = value.As<v8::Uint32>()->Value();
+    // v8 用 delete[] 释放
+    char* payload = new char[sizeof(moduleId)];
+    memcpy(payload, &moduleId, sizeof(moduleId));
+    return { payload, static_cast<int>(sizeof(moduleId)) };
+}
+
+void ModuleRegistry::deserializeModuleId(v8::Local<v8::Object> holder, int index, v8::StartupData payload, void*) {
+    uint32_t moduleId;
+    if (payload.raw_size != static_cast<int>(sizeof(moduleId))) {
+        return;
+    }
+    memcpy(&moduleId, payload.data, sizeof(moduleId));
+    holder->SetInternalField(index, v8::Integer::NewFromUnsigned(holder->GetIsolate(), moduleId));
+}
+
+uint32_t ModuleRegistry::findByName(v8::Isolate* isolate, v8::Local<v8::Name> property) const {
+    if (!property->IsString()) {
+        return kInvalidModuleId;
+    }
+    uint32_t pathId = paths_.find(*v8::String::Utf8Value(isolate, property));
+    return pathId == kInvalidPathId ? kInvalidModuleId : find(pathId);
+}
+
+v8::Local<v8::Object> ModuleRegistry::newCacheView(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    if (cacheTemplate_.IsEmpty()) {
+        v8::Local<v8::ObjectTemplate> objectTemplate = v8::ObjectTemplate::New(isolate);
+        objectTemplate->SetHandler(v8::NamedPropertyHandlerConfiguration(
+                cacheGetter, cacheSetter, cacheQuery, cacheDeleter, cacheEnumerator,
+                v8::Local<v8::Value>(), v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+        cacheTemplate_.Reset(isolate, objectTemplate);
+    }
+    return cacheTemplate_.Get(isolate)->NewInstance(context).ToLocalChecked();
+}
+
+void ModuleRegistry::cacheGetter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    ModuleRegistry* registry = from(isolate);
+    uint32_t moduleId = registry->findByName(isolate, property);
+    if (moduleId != kInvalidModuleId) {
+        info.GetReturnValue().Set(registry->get(isolate, moduleId));
+    }
+}
+
+void ModuleRegistry::cacheSetter(v8::Local<v8::Name> property, v8::Local<v8::Value> value,
+                                 const v8::PropertyCallbackInfo<v8::Value>& info) {
+    // 只读视图，拦截所有赋值
+    info.GetReturnValue().Set(value);
+}
+
+void ModuleRegistry::cacheQuery(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Integer>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    if (from(isolate)->findByName(isolate, property) != kInvalidModuleId) {
+        info.GetReturnValue().Set(v8::ReadOnly | v8::DontDelete);
+    }
+}
+
+void ModuleRegistry::cacheDeleter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Boolean>& info) {
+    // 只读视图，拦截所有删除
+    info.GetReturnValue().Set(false);
+}
+
+void ModuleRegistry::cacheEnumerator(const v8::PropertyCallbackInfo<v8::Array>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    ModuleRegistry* registry = from(isolate);
+    std::vector<v8::Local<v8::Value>> names;
+    names.reserve(registry->size());
+    for (uint32_t moduleId = 0; moduleId < registry->size(); ++moduleId) {
+        if (registry->modules_[moduleId].IsEmpty()) {
+            continue;
+        }
+        const std::string& path = registry->paths_.path(registry->pathIds_[moduleId]);
+        names.push_back(v8::String::NewFromUtf8(isolate, path.data(), v8::NewStringType::kNormal,
+                                                static_cast<int>(path.size())).ToLocalChecked());
+    }
+    info.GetReturnValue().Set(v8::Array::New(isolate, names.data(), names.size()));
+}
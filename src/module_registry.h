@@ -0,0 +1,218 @@
+#ifndef COMMONJS_SERVER_MODULE_REGISTRY_H
+#define COMMONJS_SERVER_MODULE_REGISTRY_H
+
+#include <cstdint>
+#include <vector>
+#include "v8.h"
+#include "path_resolver.h"
+
+// 无效的模块 id
+const uint32_t kInvalidModuleId = UINT32_MAX;
+// isolate 数据槽中保存模块注册表的位置
+const uint32_t kModuleRegistrySlot = 0;
+
+// module 对象的内部字段
+enum ModuleField {
+    // 模块 id，指回注册表中的模块记录
+    kModuleIdField,
+    kModuleFieldCount
+};
+
+/**
+ * 原生模块注册表，取代以路径字符串为 key 的 js 缓存对象。
+ * 模块按注册顺序分配连续的整数 id，路径 id 到模块 id 的映射是一个以路径 id 为下标的数组，
+ * 查找不需要创建 v8 字符串，模块数量再多也是 O(1)。
+ */
+class ModuleRegistry {
+public:
+    explicit ModuleRegistry(PathTable& paths) : paths_(paths) {}
+
+    /**
+     * 把注册表挂到 isolate 上，require.cache 的拦截器通过 isolate 找到注册表。
+     * 同时创建 module 对象的属性名，每个 isolate 只创建一次
+     * @param isolate
+     */
+    void attach(v8::Isolate* isolate);
+
+    /**
+     * 获取 isolate 上的注册表
+     * @param isolate
+     * @return
+     */
+    static ModuleRegistry* from(v8::Isolate* isolate);
+
+    /**
+     * 注册模块。同一路径重复注册(包括被驱逐之后重新加载)时替换原来的模块对象，模块 id 不变
+     * @param isolate
+     * @param pathId 模块绝对路径 id
+     * @param module module 对象
+     * @return 模块 id
+     */
+    uint32_t add(v8::Isolate* isolate, uint32_t pathId, v8::Local<v8::Object> module);
+
+    /**
+     * module 对象的模板。所有 module 对象都由它创建，依次带有 uri、exports 和 dependencies，
+     * 共用同一个隐藏类，加载器读取 exports 时保持单态。第一次创建 module 对象之前可以继续往模板上添加属性
+     * @param isolate
+     * @return
+     */
+    v8::Local<v8::ObjectTemplate> moduleTemplate(v8::Isolate* isolate);
+
+    /**
+     * 创建并注册 module 对象，内部字段保存模块 id
+     * @param isolate
+     * @param context
+     * @param pathId 模块绝对路径 id
+     * @param exports 模块的初始 exports
+     * @param moduleId 输出模块 id
+     * @return module 对象
+     */
+    v8::Local<v8::Object> create(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t pathId,
+                                 v8::Local<v8::Value> exports, uint32_t& moduleId);
+
+    /**
+     * 读取模块的 module.exports
+     * @param isolate
+     * @param context
+     * @param moduleId
+     * @return
+     */
+    v8::MaybeLocal<v8::Value> exports(v8::Isolate* isolate, v8::Local<v8::Context> context, uint32_t moduleId) const {
+        return get(isolate, moduleId)->Get(context, exportsKey_.Get(isolate));
+    }
+
+    /**
+     * module 对象对应的模块 id
+     * @param module 由 create 创建的 module 对象
+     * @return
+     */
+    static uint32_t moduleId(v8::Local<v8::Object> module) {
+        return module->GetInternalField(kModuleIdField).As<v8::Uint32>()->Value();
+    }
+
+    v8::Local<v8::String> uriKey(v8::Isolate* isolate) const { return uriKey_.Get(isolate); }
+
+    v8::Local<v8::String> exportsKey(v8::Isolate* isolate) const { return exportsKey_.Get(isolate); }
+
+    v8::Local<v8::String> dependenciesKey(v8::Isolate* isolate) const { return dependenciesKey_.Get(isolate); }
+
+    /**
+     * 根据路径查找模块 id
+     * @param pathId
+     * @return 未注册或者已被驱逐时返回 kInvalidModuleId
+     */
+    uint32_t find(uint32_t pathId) const {
+        uint32_t moduleId = pathId < byPath_.size() ? byPath_[pathId] : kInvalidModuleId;
+        return moduleId != kInvalidModuleId && !modules_[moduleId].IsEmpty() ? moduleId : kInvalidModuleId;
+    }
+
+    /**
+     * 驱逐模块，下次 require 时重新加载。模块 id 保留给重新加载的模块
+     * @param moduleId
+     */
+    void evict(uint32_t moduleId) {
+        modules_[moduleId].Reset();
+    }
+
+    /**
+     * 模块是否仍在注册表中，被驱逐之后直到重新加载之前为 false
+     * @param moduleId
+     * @return
+     */
+    bool loaded(uint32_t moduleId) const {
+        return moduleId < modules_.size() && !modules_[moduleId].IsEmpty();
+    }
+
+    v8::Local<v8::Object> get(v8::Isolate* isolate, uint32_t moduleId) const {
+        return modules_[moduleId].Get(isolate);
+    }
+
+    uint32_t pathId(uint32_t moduleId) const { return pathIds_[moduleId]; }
+
+    const PathTable& paths() const { return paths_; }
+
+    /**
+     * 记录开始执行的模块。define 不知道自己在哪个文件中，通过正在执行的模块找到模块路径；
+     * 嵌套 require 的模块执行完之后出栈，自动回到父模块
+     * @param pathId 模块绝对路径 id
+     */
+    void pushLoading(uint32_t pathId) { loading_.push_back(pathId); }
+
+    void popLoading() { loading_.pop_back(); }
+
+    /**
+     * 正在执行的模块
+     * @return 没有模块在执行时返回 kInvalidPathId
+     */
+    uint32_t loading() const { return loading_.empty() ? kInvalidPathId : loading_.back(); }
+
+    size_t size() const { return modules_.size(); }
+
+    /**
+     * 释放所有模块对象和模板
+     */
+    void clear();
+
+    /**
+     * 创建 require.cache 只读视图。属性名为模块绝对路径，值为 module 对象
+     * @param isolate
+     * @param context
+     * @return
+     */
+    v8::Local<v8::Object> newCacheView(v8::Isolate* isolate, v8::Local<v8::Context> context);
+
+    /**
+     * 构建快照时序列化内部字段。module 对象和 require 对象的内部字段保存模块 id(Smi)，
+     * 没有回调时 v8 会把非 0 的 Smi 当作对齐指针交给空的回调而崩溃。
+     * 恢复时注册表按快照中的顺序重建，模块 id 不变，原样写入即可；0 与 v8 的默认处理相同，不需要写入
+     * @param holder
+     * @param index 内部字段的下标
+     * @param data
+     * @return 模块 id，不是 Smi 的字段(堆对象由 v8 自己序列化)返回空
+     */
+    static v8::StartupData serializeModuleId(v8::Local<v8::Object> holder, int index, void* data);
+
+    /**
+     * 从快照恢复上下文时写回 serializeModuleId 保存的模块 id
+     * @param holder
+     * @param index 内部字段的下标
+     * @param payload
+     * @param data
+     */
+    static void deserializeModuleId(v8::Local<v8::Object> holder, int index, v8::StartupData payload, void* data);
+
+    // require.cache 的拦截器，需要登记到快照的 external references 中
+    static void cacheGetter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Value>& info);
+    static void cacheSetter(v8::Local<v8::Name> property, v8::Local<v8::Value> value,
+                            const v8::PropertyCallbackInfo<v8::Value>& info);
+    static void cacheQuery(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Integer>& info);
+    static void cacheDeleter(v8::Local<v8::Name> property, const v8::PropertyCallbackInfo<v8::Boolean>& info);
+    static void cacheEnumerator(const v8::PropertyCallbackInfo<v8::Array>& info);
+
+private:
+    /**
+     * 根据属性名查找模块 id
+     * @param isolate
+     * @param property
+     * @return
+     */
+    uint32_t findByName(v8::Isolate* isolate, v8::Local<v8::Name> property) const;
+
+    PathTable& paths_;
+    // 路径 id -> 模块 id
+    std::vector<uint32_t> byPath_;
+    // 模块 id -> module 对象
+    std::vector<v8::Global<v8::Object>> modules_;
+    // 模块 id -> 路径 id
+    std::vector<uint32_t> pathIds_;
+    // 正在执行的模块路径 id 栈
+    std::vector<uint32_t> loading_;
+    v8::Global<v8::ObjectTemplate> cacheTemplate_;
+    v8::Global<v8::ObjectTemplate> moduleTemplate_;
+    // module 对象的属性名
+    v8::Eternal<v8::String> uriKey_;
+    v8::Eternal<v8::String> exportsKey_;
+    v8::Eternal<v8::String> dependenciesKey_;
+};
+
+#endif //COMMONJS_SERVER_MODULE_REGISTRY_H
@@ -0,0 +1,60 @@
+#include "module_trace.h"
+
+namespace {
+
+const char kCategory[] = "module";
+// 与 v8 trace_event_common.h 中的定义一致
+const char kPhaseComplete = 'X';
+const uint8_t kValueTypeCopyString = 7;
+const unsigned int kFlagNone = 0;
+
+}
+
+const uint8_t ModuleTrace::kDisabled = 0;
+
+std::unique_ptr<v8::TracingController> ModuleTrace::create(const char* path) {
+    out_.open(path, std::ios::trunc);
+    if (!out_) {
+        return nullptr;
+    }
+    controller_ = new v8::platform::tracing::TracingController();
+    controller_->Initialize(v8::platform::tracing::TraceBuffer::CreateTraceBufferRingBuffer(
+            v8::platform::tracing::TraceBuffer::kRingBufferChunks,
+            v8::platform::tracing::TraceWriter::CreateJSONTraceWriter(out_)));
+    enabled_ = controller_->GetCategoryGroupEnabled(kCategory);
+    return std::unique_ptr<v8::TracingController>(controller_);
+}
+
+void ModuleTrace::start() {
+    if (controller_ == nullptr) {
+        return;
+    }
+    v8::platform::tracing::TraceConfig* config = new v8::platform::tracing::TraceConfig();
+    config->SetTraceRecordMode(v8::platform::tracing::RECORD_UNTIL_FULL);
+    config->AddIncludedCategory(kCategory);
+    // controller 接管 config
+    controller_->StartTracing(config);
+}
+
+void ModuleTrace::stop() {
+    if (controller_ == nullptr) {
+        return;
+    }
+    controller_->StopTracing();
+    controller_ = nullptr;
+    enabled_ = &kDisabled;
+}
+
+uint64_t ModuleTrace::begin(const char* name, const char* path) {
+    const char* argNames[] = { "path" };
+    const uint8_t argTypes[] = { kValueTypeCopyString };
+    const uint64_t argValues[] = { reinterpret_cast<uint64_t>(path) };
+    return controller_->AddTraceEvent(kPhaseComplete, enabled_, name, nullptr, 0, 0,
+                                      1, argNames, argTypes, argValues, nullptr, kFlagNone);
+}
+
+void ModuleTrace::end(const char* name, uint64_t handle) {
+    if (controller_ != nullptr) {
+        controller_->UpdateTraceEventDuration(enabled_, name, handle);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef COMMONJS_SERVER_MODULE_TRACE_H
+#define COMMONJS_SERVER_MODULE_TRACE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include "v8.h"
+#include "libplatform/v8-tracing.h"
+
+/**
+ * 模块加载追踪。--trace-modules=<file> 时创建 libplatform 的 TracingController 交给平台，
+ * 模块加载的各个阶段以 "module" 分类的完整事件(phase X)写入 Chrome trace JSON，
+ * require 是同步嵌套的，子模块的事件自然落在父模块的 load 事件之内。
+ */
+class ModuleTrace {
+public:
+    /**
+     * 打开输出文件并创建 tracing controller，必须在创建平台之前调用
+     * @param path 输出文件
+     * @return 交给 NewDefaultPlatform 的 tracing controller，文件无法打开时返回空
+     */
+    std::unique_ptr<v8::TracingController> create(const char* path);
+
+    /**
+     * 开始记录
+     */
+    void start();
+
+    /**
+     * 停止记录并把缓冲的事件写入文件。必须在平台销毁之前调用，文件的结尾在平台销毁时写入
+     */
+    void stop();
+
+    bool enabled() const { return *enabled_ != 0; }
+
+    /**
+     * 记录一个阶段的开始
+     * @param name 阶段名，必须是字面量
+     * @param path 模块路径或者 require 的模块标识，会被拷贝
+     * @return 事件句柄
+     */
+    uint64_t begin(const char* name, const char* path);
+
+    /**
+     * 记录阶段的结束
+     * @param name 与 begin 相同
+     * @param handle begin 返回的句柄
+     */
+    void end(const char* name, uint64_t handle);
+
+private:
+    std::ofstream out_;
+    // 由平台持有
+    v8::platform::tracing::TracingController* controller_ = nullptr;
+    // "module" 分类是否开启，没有追踪时指向常量 0
+    const uint8_t* enabled_ = &kDisabled;
+    static const uint8_t kDisabled;
+};
+
+/**
+ * 作用域内的追踪事件，追踪关闭时只有一次判断
+ */
+class TraceSpan {
+public:
+    TraceSpan(ModuleTrace& trace, const char* name, const char* path) : trace_(trace), name_(name) {
+        if (trace_.enabled()) {
+            handle_ = trace_.begin(name_, path);
+            open_ = true;
+        }
+    }
+
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /**
+     * 提前结束事件
+     */
+    void end() {
+        if (open_) {
+            trace_.end(name_, handle_);
+            open_ = false;
+        }
+    }
+
+private:
+    ModuleTrace& trace_;
+    const char* name_;
+    uint64_t handle_ = 0;
+    bool open_ = false;
+};
+
+#endif //COMMONJS_SERVER_MODULE_TRACE_H
@@ -0,0 +1,122 @@
+#include "module_watcher.h"
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+// 合并同一次保存产生的多个事件的等待时间(毫秒)
+const int kSettleMillis = 50;
+
+}
+
+ModuleWatcher::~ModuleWatcher() {
+    stop();
+}
+
+bool ModuleWatcher::start() {
+    if (fd_ < 0) {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    return fd_ >= 0;
+}
+
+void ModuleWatcher::stop() {
+    if (loop_ != nullptr) {
+        if (settleTimer_ != 0) {
+            loop_->clearTimer(settleTimer_);
+        }
+        loop_->remove(fd_);
+    }
+    loop_ = nullptr;
+    settleTimer_ = 0;
+    pending_.clear();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = -1;
+    directories_.clear();
+    watchedDirectories_.clear();
+    watched_.clear();
+}
+
+void ModuleWatcher::watch(uint32_t pathId) {
+    if (fd_ < 0) {
+        return;
+    }
+    if (pathId >= watched_.size()) {
+        watched_.resize(pathId + 1, false);
+    }
+    watched_[pathId] = true;
+    uint32_t dirId = paths_.dirname(pathId);
+    if (dirId >= watchedDirectories_.size()) {
+        watchedDirectories_.resize(dirId + 1, false);
+    }
+    if (watchedDirectories_[dirId]) {
+        return;
+    }
+    watchedDirectories_[dirId] = true;
+    // 写入完成和 rename 覆盖两种保存方式；创建、删除和移走的目录项会改变 require 的解析结果
+    int wd = inotify_add_watch(fd_, paths_.path(dirId).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+    if (wd >= 0) {
+        directories_[wd] = dirId;
+    }
+}
+
+void ModuleWatcher::read(std::vector<uint32_t>& changed) {
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return;
+        }
+        for (char* pointer = buffer; pointer < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(pointer);
+            pointer += sizeof(struct inotify_event) + event->len;
+            auto iterator = directories_.find(event->wd);
+            if (iterator == directories_.end() || event->len == 0) {
+                continue;
+            }
+            const std::string& directory = paths_.path(iterator->second);
+            if (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+                // 比如修改后的模块 require 了新建的文件，缓存的解析结果和目录项已经过期
+                resolver_.invalidate(directory, event->name);
+            }
+            if (!(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                continue;
+            }
+            // 目录下的其他文件还没有驻留时不需要创建新的路径 id
+            uint32_t pathId = paths_.find(directory + (has_suffix(directory, "/") ? "" : "/") + event->name);
+            if (pathId == kInvalidPathId || pathId >= watched_.size() || !watched_[pathId]) {
+                continue;
+            }
+            if (std::find(changed.begin(), changed.end(), pathId) == changed.end()) {
+                changed.push_back(pathId);
+            }
+        }
+    }
+}
+
+bool ModuleWatcher::listen(EventLoop& loop, ChangeCallback callback) {
+    if (fd_ < 0 || !loop.add(fd_, EPOLLIN, [this, callback](uint32_t) {
+        read(pending_);
+        if (pending_.empty()) {
+            return;
+        }
+        // 一次保存可能产生多个事件，等到一段时间内没有新事件为止
+        if (settleTimer_ != 0) {
+            loop_->clearTimer(settleTimer_);
+        }
+        settleTimer_ = loop_->setTimer(kSettleMillis, [this, callback]() {
+            settleTimer_ = 0;
+            std::vector<uint32_t> changed;
+            changed.swap(pending_);
+            callback(changed);
+        });
+    })) {
+        return false;
+    }
+    loop_ = &loop;
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef COMMONJS_SERVER_MODULE_WATCHER_H
+#define COMMONJS_SERVER_MODULE_WATCHER_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "event_loop.h"
+#include "path_resolver.h"
+
+/**
+ * 基于 inotify 的模块文件监听。监听的是模块所在的目录而不是文件本身，
+ * 编辑器先写临时文件再 rename 覆盖的保存方式也能收到事件。
+ * 目录中有文件被创建、删除或者移动时通知路径解析器丢弃过期的目录项和解析结果。
+ */
+class ModuleWatcher {
+public:
+    /**
+     * 模块发生变化时的回调
+     * @param changed 发生变化的模块路径 id
+     */
+    typedef std::function<void(const std::vector<uint32_t>& changed)> ChangeCallback;
+
+    explicit ModuleWatcher(PathResolver& resolver) : resolver_(resolver), paths_(resolver.paths()) {}
+    ~ModuleWatcher();
+
+    ModuleWatcher(const ModuleWatcher&) = delete;
+    ModuleWatcher& operator=(const ModuleWatcher&) = delete;
+
+    /**
+     * 创建 inotify 实例
+     * @return 是否成功
+     */
+    bool start();
+
+    bool started() const { return fd_ >= 0; }
+
+    // inotify 文件描述符，可读时表示有事件
+    int fd() const { return fd_; }
+
+    /**
+     * 监听模块文件，同一目录只添加一次监听
+     * @param pathId 模块绝对路径 id
+     */
+    void watch(uint32_t pathId);
+
+    /**
+     * 读取当前所有待处理的事件，不阻塞
+     * @param changed 输出发生变化的模块路径 id，已经去重
+     */
+    void read(std::vector<uint32_t>& changed);
+
+    /**
+     * 把 inotify 注册到事件循环。收到事件后用定时器再等待一小段时间，
+     * 把编辑器一次保存产生的多个事件合并成一次变化。inotify 句柄会让循环一直运行，直到 stop
+     * @param loop
+     * @param callback
+     * @return 是否成功
+     */
+    bool listen(EventLoop& loop, ChangeCallback callback);
+
+    void stop();
+
+private:
+    PathResolver& resolver_;
+    PathTable& paths_;
+    int fd_ = -1;
+    EventLoop* loop_ = nullptr;
+    // 合并事件的定时器，没有时为 0
+    uint64_t settleTimer_ = 0;
+    // 等待合并的变化
+    std::vector<uint32_t> pending_;
+    // inotify watch descriptor -> 目录路径 id
+    std::unordered_map<int, uint32_t> directories_;
+    // 已经监听的目录路径 id
+    std::vector<bool> watchedDirectories_;
+    // 以路径 id 为下标，被监听的模块文件
+    std::vector<bool> watched_;
+};
+
+#endif //COMMONJS_SERVER_MODULE_WATCHER_H
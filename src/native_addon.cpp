@@ -0,0 +1,72 @@
+#include "native_addon.h"
+#include <dlfcn.h>
+
+namespace {
+
+/**
+ * 注册函数使用的 AddonExports，直接写入模块的 exports 对象
+ */
+class ExportsBuilder : public AddonExports {
+public:
+    ExportsBuilder(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Object> exports)
+            : isolate_(isolate), context_(context), exports_(exports) {}
+
+    v8::Isolate* isolate() const override { return isolate_; }
+
+    v8::Local<v8::Context> context() const override { return context_; }
+
+    void setFunction(const char* name, v8::FunctionCallback callback, const v8::CFunction* fastCallback, int length) override {
+        // 快路径挂在函数模板上，TurboFan 优化调用点时直接调用 C 函数，跳过 FunctionCallbackInfo
+        v8::Local<v8::FunctionTemplate> functionTemplate = v8::FunctionTemplate::New(
+                isolate_, callback, v8::Local<v8::Value>(), v8::Local<v8::Signature>(), length,
+                v8::ConstructorBehavior::kThrow, v8::SideEffectType::kHasSideEffect, fastCallback);
+        v8::Local<v8::Function> function;
+        if (functionTemplate->GetFunction(context_).ToLocal(&function)) {
+            setValue(name, function);
+        }
+    }
+
+    void setValue(const char* name, v8::Local<v8::Value> value) override {
+        exports_->Set(context_, v8::String::NewFromUtf8(isolate_, name).ToLocalChecked(), value).FromJust();
+    }
+
+private:
+    v8::Isolate* isolate_;
+    v8::Local<v8::Context> context_;
+    v8::Local<v8::Object> exports_;
+};
+
+void throwError(v8::Isolate* isolate, const std::string& message) {
+    isolate->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8(isolate, message.data(), v8::NewStringType::kNormal,
+                                                                         static_cast<int>(message.size())).ToLocalChecked()));
+}
+
+}
+
+v8::MaybeLocal<v8::Object> NativeAddons::load(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path) {
+    if (!enabled_) {
+        throwError(isolate, "构建快照时不能加载原生模块: " + path);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        throwError(isolate, std::string("加载原生模块失败: ") + dlerror());
+        return v8::MaybeLocal<v8::Object>();
+    }
+    AddonRegisterFunction registerAddon = reinterpret_cast<AddonRegisterFunction>(dlsym(handle, COMMONJS_ADDON_SYMBOL));
+    if (registerAddon == nullptr) {
+        dlclose(handle);
+        throwError(isolate, "原生模块没有导出 " COMMONJS_ADDON_SYMBOL ": " + path);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    v8::EscapableHandleScope handleScope(isolate);
+    v8::Local<v8::Object> exports = v8::Object::New(isolate);
+    ExportsBuilder builder(isolate, context, exports);
+    v8::TryCatch tryCatch(isolate);
+    registerAddon(builder);
+    if (tryCatch.HasCaught()) {
+        tryCatch.ReThrow();
+        return v8::MaybeLocal<v8::Object>();
+    }
+    return handleScope.Escape(exports);
+}
@@ -0,0 +1,33 @@
+#ifndef COMMONJS_SERVER_NATIVE_ADDON_H
+#define COMMONJS_SERVER_NATIVE_ADDON_H
+
+#include <string>
+#include "v8.h"
+#include "addon.h"
+
+/**
+ * 原生模块加载器。dlopen 共享库，找到 COMMONJS_ADDON 导出的注册函数，用它填充模块的 exports。
+ * 共享库加载之后不再卸载，热重载时 dlopen 返回同一个句柄，注册函数重新生成 exports。
+ */
+class NativeAddons {
+public:
+    /**
+     * 构建快照时原生函数不在 external references 中，必须禁止加载
+     * @param enabled
+     */
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    /**
+     * 加载原生模块
+     * @param isolate
+     * @param context
+     * @param path 共享库绝对路径
+     * @return 模块的 exports，失败时抛出异常并返回空
+     */
+    v8::MaybeLocal<v8::Object> load(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path);
+
+private:
+    bool enabled_ = true;
+};
+
+#endif //COMMONJS_SERVER_NATIVE_ADDON_H
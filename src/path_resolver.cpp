@@ -0,0 +1,182 @@
+#include "path_resolver.h"
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include "module_archive.h"
+
+namespace {
+
+// 依次尝试的文件后缀
+const char* const kExtensions[] = { "", ".js", ".json" };
+// 目录下依次尝试的入口文件
+const char* const kIndexFiles[] = { "/index.js", "/index.json" };
+
+/**
+ * 是否为相对路径或者绝对路径，其余的标识需要查找 node_modules
+ * @param specifier
+ * @return
+ */
+bool isPathSpecifier(const std::string& specifier) {
+    return specifier[0] == '/' || specifier == "." || specifier == ".." ||
+           specifier.compare(0, 2, "./") == 0 || specifier.compare(0, 3, "../") == 0;
+}
+
+}
+
+std::string getAbsolutePath(const std::string& path,
+                            const std::string& dir) {
+    std::string absolute_path;
+    // 判断是否为绝对路径。在linux 上下。文件以 / 开头
+    if ( path[0] == '/') {
+        absolute_path = path;
+    } else {
+        absolute_path = dir + '/' + path;
+    }
+    std::replace(absolute_path.begin(), absolute_path.end(), '\\', '/');
+    std::vector<std::string> segments;
+    std::istringstream segment_stream(absolute_path);
+    std::string segment;
+    while (std::getline(segment_stream, segment, '/')) {
+        if (segment == "..") {
+            // 绝对路径的第一段是表示根目录的空串，根目录的上级仍然是根目录
+            if (!segments.empty() && !(segments.size() == 1 && segments[0].empty())) {
+                segments.pop_back();
+            }
+        } else if (segment != "." && (!segment.empty() || segments.empty())) {
+            // 连续的 / 只保留开头的一个
+            segments.push_back(segment);
+        }
+    }
+    if (segments.empty()) {
+        return ".";
+    }
+    if (segments.size() == 1 && segments[0].empty()) {
+        return "/";
+    }
+    std::ostringstream os;
+    std::copy(segments.begin(), segments.end() - 1,
+              std::ostream_iterator<std::string>(os, "/"));
+    os << *segments.rbegin();
+    return os.str();
+}
+
+uint32_t PathTable::intern(const std::string& path) {
+    auto result = ids_.emplace(path, static_cast<uint32_t>(paths_.size()));
+    if (result.second) {
+        paths_.push_back(&result.first->first);
+        dirs_.push_back(kInvalidPathId);
+    }
+    return result.first->second;
+}
+
+uint32_t PathTable::find(const std::string& path) const {
+    auto iterator = ids_.find(path);
+    return iterator == ids_.end() ? kInvalidPathId : iterator->second;
+}
+
+uint32_t PathTable::dirname(uint32_t id) {
+    if (dirs_[id] == kInvalidPathId) {
+        const std::string& value = path(id);
+        size_t index = value.find_last_of('/');
+        // 根目录下的文件所在目录为 /
+        uint32_t dirId = intern(index == std::string::npos || index == 0 ? std::string("/") : value.substr(0, index));
+        dirs_[id] = dirId;
+    }
+    return dirs_[id];
+}
+
+bool PathResolver::isFile(const std::string& path) {
+    if (archive_ != nullptr && archive_->find(path) >= 0) {
+        return true;
+    }
+    return directories_.stat(path) == DirectoryCache::EntryType::kFile;
+}
+
+bool PathResolver::resolveFile(const std::string& path, std::string& resolved) {
+    for (const char* extension : kExtensions) {
+        std::string candidate = path + extension;
+        if (isFile(candidate)) {
+            resolved = std::move(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathResolver::resolveIndex(const std::string& dir, std::string& resolved) {
+    for (const char* indexFile : kIndexFiles) {
+        std::string candidate = dir + indexFile;
+        if (isFile(candidate)) {
+            resolved = std::move(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathResolver::resolveDirectory(const std::string& dir, std::string& resolved) {
+    if (directories_.stat(dir) != DirectoryCache::EntryType::kDirectory) {
+        return false;
+    }
+    const std::string& main = directories_.packageMain(dir);
+    if (!main.empty()) {
+        std::string mainPath = getAbsolutePath(main, dir);
+        if (resolveFile(mainPath, resolved) || resolveIndex(mainPath, resolved)) {
+            return true;
+        }
+    }
+    return resolveIndex(dir, resolved);
+}
+
+bool PathResolver::resolvePath(const std::string& path, std::string& resolved) {
+    return resolveFile(path, resolved) || resolveDirectory(path, resolved);
+}
+
+bool PathResolver::resolveNodeModules(const std::string& dir, const std::string& specifier, std::string& resolved) {
+    std::string current = dir;
+    while (true) {
+        size_t index = current.find_last_of('/');
+        // node_modules 目录本身下面不再嵌套查找 node_modules/node_modules
+        if (current.compare(index + 1, std::string::npos, "node_modules") != 0) {
+            std::string base = current == "/" ? std::string() : current;
+            if (resolvePath(getAbsolutePath(specifier, base + "/node_modules"), resolved)) {
+                return true;
+            }
+        }
+        if (current == "/" || index == std::string::npos) {
+            return false;
+        }
+        current = index == 0 ? std::string("/") : current.substr(0, index);
+    }
+}
+
+uint32_t PathResolver::resolve(uint32_t dirId, const std::string& specifier) {
+    Key key{dirId, specifier};
+    auto iterator = resolved_.find(key);
+    if (iterator != resolved_.end()) {
+        return iterator->second;
+    }
+    const std::string& dir = paths_.path(dirId);
+    std::string resolved;
+    bool found = !specifier.empty() && !isPathSpecifier(specifier) && resolveNodeModules(dir, specifier, resolved);
+    if (!found && !specifier.empty()) {
+        found = resolvePath(getAbsolutePath(specifier, dir), resolved);
+    }
+    if (!found) {
+        std::string modulePath = specifier;
+        if (!has_suffix(modulePath, std::string(".js"))) {
+            modulePath.append(".js");
+        }
+        resolved = getAbsolutePath(modulePath, dir);
+    }
+    uint32_t id = paths_.intern(resolved);
+    resolved_.emplace(std::move(key), id);
+    return id;
+}
+
+void PathResolver::invalidate(const std::string& dir, const std::string& name) {
+    directories_.invalidate(dir);
+    // 新建的子目录(比如 node_modules)之前可能作为不存在的目录缓存过
+    directories_.invalidate(has_suffix(dir, "/") ? dir + name : dir + "/" + name);
+    resolved_.clear();
+}
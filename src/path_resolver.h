@@ -0,0 +1,136 @@
+#ifndef COMMONJS_SERVER_PATH_RESOLVER_H
+#define COMMONJS_SERVER_PATH_RESOLVER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "directory_cache.h"
+
+class ModuleArchive;
+
+// 无效的路径 id
+const uint32_t kInvalidPathId = UINT32_MAX;
+
+/**
+ * 判断字符串是否以某个 后缀为结尾
+ * @param str
+ * @param suffix
+ * @return
+ */
+inline bool has_suffix(const std::string &str, const std::string &suffix){
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * 技术路径path相对于 dir的绝对路径
+ * @param path 文件路径
+ * @param dir_name 目录
+ * @return
+ */
+std::string getAbsolutePath(const std::string& path,
+                            const std::string& dir);
+
+/**
+ * 路径驻留表。每个绝对路径只保存一份，用连续的整数 id 表示。
+ */
+class PathTable {
+public:
+    /**
+     * 驻留路径，已存在时直接返回原来的 id
+     * @param path 绝对路径
+     * @return
+     */
+    uint32_t intern(const std::string& path);
+
+    /**
+     * 查找路径的 id
+     * @param path
+     * @return 不存在时返回 kInvalidPathId
+     */
+    uint32_t find(const std::string& path) const;
+
+    const std::string& path(uint32_t id) const { return *paths_[id]; }
+
+    /**
+     * 路径所在目录的 id，结果会被记住
+     * @param id
+     * @return
+     */
+    uint32_t dirname(uint32_t id);
+
+private:
+    std::unordered_map<std::string, uint32_t> ids_;
+    // 指向 ids_ 中的 key，unordered_map 扩容时节点地址不变
+    std::vector<const std::string*> paths_;
+    // 每个路径所在目录的 id，未计算时为 kInvalidPathId
+    std::vector<uint32_t> dirs_;
+};
+
+/**
+ * require 的路径解析。支持 node 风格的解析规则：
+ *  相对路径和绝对路径依次尝试 文件本身、.js、.json，再作为目录尝试 package.json 的 main、index.js、index.json；
+ *  其他标识先从父模块目录开始逐级查找 node_modules，找不到时按相对路径解析(兼容原来的写法)。
+ * 候选路径是否存在由目录项缓存判断，不会产生失败的 open。
+ * 解析结果以 (父模块目录 id, 模块标识) 为 key 缓存，重复的 require 只需要一次 hash 查找。
+ */
+class PathResolver {
+public:
+    explicit PathResolver(PathTable& paths) : paths_(paths) {}
+
+    /**
+     * 解析模块标识。找不到模块时与原来一样补上 .js 后缀，由加载时报告文件不存在
+     * @param dirId 父模块所在目录的 id
+     * @param specifier require 的参数
+     * @return 模块绝对路径的 id
+     */
+    uint32_t resolve(uint32_t dirId, const std::string& specifier);
+
+    /**
+     * 设置模块归档，归档中的模块即使磁盘上不存在也可以被解析到
+     * @param archive
+     */
+    void setArchive(const ModuleArchive* archive) { archive_ = archive; }
+
+    PathTable& paths() { return paths_; }
+
+    /**
+     * 目录下有文件被创建、删除或者移动，丢弃目录项缓存和所有解析结果。
+     * 新的文件可能改变任意一个 require 的解析结果，解析结果没有记录查找过哪些目录，只能全部重新解析；
+     * 其余目录的目录项缓存保留，重新解析只是 hash 查找
+     * @param dir 发生变化的目录
+     * @param name 变化的目录项名称
+     */
+    void invalidate(const std::string& dir, const std::string& name);
+
+private:
+    struct Key {
+        uint32_t dirId;
+        std::string specifier;
+
+        bool operator==(const Key& other) const {
+            return dirId == other.dirId && specifier == other.specifier;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<std::string>()(key.specifier) * 31 + key.dirId;
+        }
+    };
+
+    bool isFile(const std::string& path);
+    bool resolveFile(const std::string& path, std::string& resolved);
+    bool resolveIndex(const std::string& dir, std::string& resolved);
+    bool resolveDirectory(const std::string& dir, std::string& resolved);
+    bool resolvePath(const std::string& path, std::string& resolved);
+    bool resolveNodeModules(const std::string& dir, const std::string& specifier, std::string& resolved);
+
+    PathTable& paths_;
+    DirectoryCache directories_;
+    const ModuleArchive* archive_ = nullptr;
+    std::unordered_map<Key, uint32_t, KeyHash> resolved_;
+};
+
+#endif //COMMONJS_SERVER_PATH_RESOLVER_H
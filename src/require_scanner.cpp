@@ -0,0 +1,146 @@
+#include "require_scanner.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+inline bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * 跳过字符串字面量，position 指向开始的引号，返回结束引号之后的位置
+ */
+size_t skipString(const char* source, size_t length, size_t position) {
+    char quote = source[position++];
+    while (position < length && source[position] != quote) {
+        if (source[position] == '\\') {
+            position++;
+        } else if (source[position] == '\n' && quote != '`') {
+            // 普通字符串不能跨行，说明不是字符串(比如正则表达式中的引号)
+            return position;
+        }
+        position++;
+    }
+    return position + 1;
+}
+
+/**
+ * 尝试解析 require( '...' ) 的参数，position 指向 require 之后的位置
+ * @return 是否解析成功
+ */
+bool parseArgument(const char* source, size_t length, size_t position, std::string& specifier) {
+    while (position < length && isSpace(source[position])) {
+        position++;
+    }
+    if (position >= length || source[position] != '(') {
+        return false;
+    }
+    position++;
+    while (position < length && isSpace(source[position])) {
+        position++;
+    }
+    if (position >= length || (source[position] != '\'' && source[position] != '"')) {
+        return false;
+    }
+    char quote = source[position++];
+    size_t start = position;
+    while (position < length && source[position] != quote) {
+        // 带转义或者跨行的不是简单的路径字面量
+        if (source[position] == '\\' || source[position] == '\n') {
+            return false;
+        }
+        position++;
+    }
+    if (position >= length || position == start) {
+        return false;
+    }
+    specifier.assign(source + start, position - start);
+    position++;
+    while (position < length && isSpace(source[position])) {
+        position++;
+    }
+    // 必须是单个参数
+    return position < length && source[position] == ')';
+}
+
+}
+
+void scanRequires(const char* source, size_t length, std::vector<std::string>& specifiers) {
+    static const char kRequire[] = "require";
+    const size_t requireLength = sizeof(kRequire) - 1;
+    size_t position = 0;
+    std::string specifier;
+    while (position < length) {
+        char c = source[position];
+        if (c == '/' && position + 1 < length && source[position + 1] == '/') {
+            // 单行注释
+            const void* end = memchr(source + position, '\n', length - position);
+            position = end == nullptr ? length : static_cast<const char*>(end) - source;
+        } else if (c == '/' && position + 1 < length && source[position + 1] == '*') {
+            // 多行注释
+            size_t end = position + 2;
+            while (end + 1 < length && !(source[end] == '*' && source[end + 1] == '/')) {
+                end++;
+            }
+            position = end + 2;
+        } else if (c == '\'' || c == '"' || c == '`') {
+            position = skipString(source, length, position);
+        } else if (c == 'r' && length - position >= requireLength &&
+                   memcmp(source + position, kRequire, requireLength) == 0 &&
+                   (position == 0 || (!isIdentifierChar(source[position - 1]) && source[position - 1] != '.')) &&
+                   (position + requireLength == length || !isIdentifierChar(source[position + requireLength]))) {
+            if (parseArgument(source, length, position + requireLength, specifier) &&
+                std::find(specifiers.begin(), specifiers.end(), specifier) == specifiers.end()) {
+                specifiers.push_back(specifier);
+            }
+            position += requireLength;
+        } else if (isIdentifierChar(c)) {
+            // 跳过整个标识符，避免匹配到 xrequire 这样的名字中间
+            while (position < length && isIdentifierChar(source[position])) {
+                position++;
+            }
+        } else {
+            position++;
+        }
+    }
+}
+
+bool isDefineModule(const char* source, size_t length) {
+    static const char kDefine[] = "define";
+    const size_t defineLength = sizeof(kDefine) - 1;
+    size_t position = 0;
+    while (position < length) {
+        if (isSpace(source[position]) || source[position] == ';') {
+            position++;
+        } else if (position + 1 < length && source[position] == '/' && source[position + 1] == '/') {
+            while (position < length && source[position] != '\n') {
+                position++;
+            }
+        } else if (position + 1 < length && source[position] == '/' && source[position + 1] == '*') {
+            const char* end = static_cast<const char*>(memmem(source + position + 2, length - position - 2, "*/", 2));
+            if (end == nullptr) {
+                return false;
+            }
+            position = end - source + 2;
+        } else if (source[position] == '\'' || source[position] == '"') {
+            // 指令序言，比如 "use strict"
+            position = skipString(source, length, position);
+        } else {
+            break;
+        }
+    }
+    if (position >= length || length - position < defineLength || memcmp(source + position, kDefine, defineLength) != 0) {
+        return false;
+    }
+    position += defineLength;
+    while (position < length && isSpace(source[position])) {
+        position++;
+    }
+    return position < length && source[position] == '(';
+}
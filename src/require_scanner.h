@@ -0,0 +1,26 @@
+#ifndef COMMONJS_SERVER_REQUIRE_SCANNER_H
+#define COMMONJS_SERVER_REQUIRE_SCANNER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * 扫描源码中静态的 require('...') 调用，返回字符串字面量形式的模块标识。
+ * 跳过注释、字符串和模板字符串中的内容；参数不是单个字符串字面量的调用(计算出来的路径)会被忽略。
+ * 只用于预取，漏掉或者多扫出来的模块都不会影响执行结果。
+ * @param source 源码
+ * @param length 源码长度
+ * @param specifiers 输出的模块标识，按出现顺序，已去重
+ */
+void scanRequires(const char* source, size_t length, std::vector<std::string>& specifiers);
+
+/**
+ * 模块是否是 define(...) 包装的写法：跳过开头的空白、注释和 "use strict" 之后以 define( 开始。
+ * 其余的模块按普通 CommonJS 模块编译成函数。
+ * @param source 源码
+ * @param length 源码长度
+ * @return
+ */
+bool isDefineModule(const char* source, size_t length);
+
+#endif //COMMONJS_SERVER_REQUIRE_SCANNER_H
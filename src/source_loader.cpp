@@ -0,0 +1,74 @@
+#include "source_loader.h"
+#include <cstring>
+#include <memory>
+
+namespace {
+
+/**
+ * 引用一段不需要释放的内存作为 v8 外部字符串的数据
+ */
+class StaticSourceResource : public v8::String::ExternalOneByteStringResource {
+public:
+    StaticSourceResource(const char* data, size_t length) : data_(data), length_(length) {}
+
+    const char* data() const override { return data_; }
+    size_t length() const override { return length_; }
+
+private:
+    const char* data_;
+    size_t length_;
+};
+
+}
+
+bool isAscii(const char* data, size_t length) {
+    const uint64_t highBits = 0x8080808080808080ULL;
+    size_t index = 0;
+    // 每次检查 8 个字节
+    for (; index + sizeof(uint64_t) <= length; index += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + index, sizeof(word));
+        if (word & highBits) {
+            return false;
+        }
+    }
+    for (; index < length; ++index) {
+        if (static_cast<uint8_t>(data[index]) & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+v8::Local<v8::String> newSourceString(v8::Isolate* isolate, std::unique_ptr<MappedFile> file) {
+    if (file->size() == 0) {
+        return v8::String::Empty(isolate);
+    }
+    // 文件可能在进程运行期间被原地改写或者截断(编辑器保存、git checkout、npm install)，
+    // 而 v8 在惰性编译、Function.prototype.toString 和生成堆栈时还会读源码，读到截断的映射会触发 SIGBUS，
+    // 所以源码总是拷贝到 v8 堆上，返回时解除映射。纯 ASCII 的源码按单字节直接拷贝，不需要 UTF-8 解码
+    if (isAscii(file->data(), file->size())) {
+        v8::Local<v8::String> source;
+        if (v8::String::NewFromOneByte(isolate, reinterpret_cast<const uint8_t*>(file->data()), v8::NewStringType::kNormal,
+                                       static_cast<int>(file->size())).ToLocal(&source)) {
+            return source;
+        }
+        return v8::Local<v8::String>();
+    }
+    return v8::String::NewFromUtf8(isolate, file->data(), v8::NewStringType::kNormal,
+                                   static_cast<int>(file->size())).ToLocalChecked();
+}
+
+v8::Local<v8::String> newSourceString(v8::Isolate* isolate, const char* data, size_t length) {
+    if (length == 0) {
+        return v8::String::Empty(isolate);
+    }
+    if (isAscii(data, length)) {
+        v8::Local<v8::String> source;
+        if (v8::String::NewExternalOneByte(isolate, new StaticSourceResource(data, length)).ToLocal(&source)) {
+            return source;
+        }
+        return v8::Local<v8::String>();
+    }
+    return v8::String::NewFromUtf8(isolate, data, v8::NewStringType::kNormal, static_cast<int>(length)).ToLocalChecked();
+}
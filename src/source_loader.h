@@ -0,0 +1,35 @@
+#ifndef COMMONJS_SERVER_SOURCE_LOADER_H
+#define COMMONJS_SERVER_SOURCE_LOADER_H
+
+#include <memory>
+#include "v8.h"
+#include "mapped_file.h"
+
+/**
+ * 判断一段内存是否全部为 ASCII 字符
+ * @param data
+ * @param length
+ * @return
+ */
+bool isAscii(const char* data, size_t length);
+
+/**
+ * 把映射的源码文件转换成 v8 字符串。文件可能被其他进程改写，源码总是拷贝到 v8 堆上，返回时解除映射；
+ * 纯 ASCII 的源码直接拷贝，其他源码按 UTF-8 解码拷贝。
+ * @param isolate
+ * @param file 已经打开的映射文件
+ * @return
+ */
+v8::Local<v8::String> newSourceString(v8::Isolate* isolate, std::unique_ptr<MappedFile> file);
+
+/**
+ * 把一段在进程生命周期内一直有效、内容不会改变的内存(比如模块归档中的源码)转换成 v8 字符串。
+ * 纯 ASCII 的源码以外部字符串引用这段内存，不拷贝。
+ * @param isolate
+ * @param data
+ * @param length
+ * @return
+ */
+v8::Local<v8::String> newSourceString(v8::Isolate* isolate, const char* data, size_t length);
+
+#endif //COMMONJS_SERVER_SOURCE_LOADER_H
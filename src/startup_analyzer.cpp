@@ -0,0 +1,211 @@
+#include "startup_analyzer.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+/**
+ * 输出毫秒，右对齐
+ * @param out
+ * @param nanoseconds
+ */
+void writeMilliseconds(std::ostream& out, int64_t nanoseconds) {
+    out << std::setw(10) << std::fixed << std::setprecision(2) << nanoseconds / 1e6 << "ms";
+}
+
+}
+
+const std::string& StartupAnalyzer::path(uint32_t moduleId) const {
+    return registry_.paths().path(registry_.pathId(moduleId));
+}
+
+void StartupAnalyzer::buildLoadTree() {
+    size_t size = registry_.size();
+    loadParent_.assign(size, kInvalidModuleId);
+    loadChildren_.assign(size, std::vector<uint32_t>());
+    exclusive_.assign(size, 0);
+    // 只有真正加载过的模块有区间；同一个 ES 模块图中被 import 的模块计入根模块
+    std::vector<uint32_t> order;
+    for (uint32_t moduleId = 0; moduleId < size; ++moduleId) {
+        // 被驱逐的模块不参与分析
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        exclusive_[moduleId] = graph_.loadTime(moduleId);
+        if (graph_.loadStart(moduleId) != 0) {
+            order.push_back(moduleId);
+        }
+    }
+    // 开始时间相同时外层区间更长，先入栈
+    std::sort(order.begin(), order.end(), [this](uint32_t left, uint32_t right) {
+        if (graph_.loadStart(left) != graph_.loadStart(right)) {
+            return graph_.loadStart(left) < graph_.loadStart(right);
+        }
+        return graph_.loadTime(left) > graph_.loadTime(right);
+    });
+    std::vector<uint32_t> stack;
+    for (uint32_t moduleId : order) {
+        while (!stack.empty() && graph_.loadStart(moduleId) >= graph_.loadStart(stack.back()) + graph_.loadTime(stack.back())) {
+            stack.pop_back();
+        }
+        if (!stack.empty()) {
+            loadParent_[moduleId] = stack.back();
+            loadChildren_[stack.back()].push_back(moduleId);
+            exclusive_[stack.back()] -= graph_.loadTime(moduleId);
+        }
+        stack.push_back(moduleId);
+    }
+    for (int64_t& exclusive : exclusive_) {
+        exclusive = std::max<int64_t>(exclusive, 0);
+    }
+}
+
+void StartupAnalyzer::computeSavings(uint32_t entryModuleId) {
+    size_t size = registry_.size();
+    savings_.assign(size, 0);
+    reachable_.assign(size, false);
+    // 依赖图的逆后序
+    std::vector<uint32_t> postOrder;
+    std::vector<std::pair<uint32_t, size_t>> stack;
+    stack.emplace_back(entryModuleId, 0);
+    reachable_[entryModuleId] = true;
+    while (!stack.empty()) {
+        uint32_t moduleId = stack.back().first;
+        const std::vector<uint32_t>& dependencies = graph_.dependencies(moduleId);
+        if (stack.back().second < dependencies.size()) {
+            uint32_t dependency = dependencies[stack.back().second++];
+            if (dependency < size && !reachable_[dependency] && registry_.loaded(dependency)) {
+                reachable_[dependency] = true;
+                stack.emplace_back(dependency, 0);
+            }
+            continue;
+        }
+        postOrder.push_back(moduleId);
+        stack.pop_back();
+    }
+    std::vector<uint32_t> reversePostOrder(postOrder.rbegin(), postOrder.rend());
+    std::vector<size_t> rank(size, 0);
+    for (size_t index = 0; index < reversePostOrder.size(); ++index) {
+        rank[reversePostOrder[index]] = index;
+    }
+
+    // Cooper-Harvey-Kennedy 迭代求直接支配者
+    std::vector<uint32_t> dominator(size, kInvalidModuleId);
+    dominator[entryModuleId] = entryModuleId;
+    auto intersect = [&](uint32_t left, uint32_t right) {
+        while (left != right) {
+            while (rank[left] > rank[right]) {
+                left = dominator[left];
+            }
+            while (rank[right] > rank[left]) {
+                right = dominator[right];
+            }
+        }
+        return left;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t index = 1; index < reversePostOrder.size(); ++index) {
+            uint32_t moduleId = reversePostOrder[index];
+            uint32_t newDominator = kInvalidModuleId;
+            for (uint32_t dependent : graph_.dependents(moduleId)) {
+                if (!reachable_[dependent] || dominator[dependent] == kInvalidModuleId) {
+                    continue;
+                }
+                newDominator = newDominator == kInvalidModuleId ? dependent : intersect(dependent, newDominator);
+            }
+            if (newDominator != kInvalidModuleId && dominator[moduleId] != newDominator) {
+                dominator[moduleId] = newDominator;
+                changed = true;
+            }
+        }
+    }
+    // 逆后序中支配者总在前面，倒序累加到支配者上
+    for (size_t index = reversePostOrder.size(); index-- > 0;) {
+        uint32_t moduleId = reversePostOrder[index];
+        savings_[moduleId] += exclusive_[moduleId];
+        if (moduleId != entryModuleId) {
+            savings_[dominator[moduleId]] += savings_[moduleId];
+        }
+    }
+}
+
+void StartupAnalyzer::report(std::ostream& out, uint32_t entryModuleId, size_t limit) {
+    if (entryModuleId == kInvalidModuleId || !registry_.loaded(entryModuleId)) {
+        out << "entry module was not loaded" << std::endl;
+        return;
+    }
+    buildLoadTree();
+    computeSavings(entryModuleId);
+    std::ios::fmtflags flags = out.flags();
+    // 只统计仍在注册表中的模块和它们之间的边
+    size_t loadedCount = 0;
+    size_t edgeCount = 0;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        if (!registry_.loaded(moduleId)) {
+            continue;
+        }
+        loadedCount++;
+        for (uint32_t dependency : graph_.dependencies(moduleId)) {
+            edgeCount += registry_.loaded(dependency) ? 1 : 0;
+        }
+    }
+
+    out << "startup:";
+    writeMilliseconds(out, graph_.loadTime(entryModuleId));
+    out << "  modules: " << loadedCount << "  edges: " << edgeCount << std::endl;
+
+    out << std::endl << "critical path (inclusive / exclusive):" << std::endl;
+    for (uint32_t moduleId = entryModuleId; moduleId != kInvalidModuleId;) {
+        writeMilliseconds(out, graph_.loadTime(moduleId));
+        writeMilliseconds(out, exclusive_[moduleId]);
+        out << "  " << path(moduleId) << std::endl;
+        uint32_t next = kInvalidModuleId;
+        for (uint32_t child : loadChildren_[moduleId]) {
+            if (next == kInvalidModuleId || graph_.loadTime(child) > graph_.loadTime(next)) {
+                next = child;
+            }
+        }
+        moduleId = next;
+    }
+
+    std::vector<uint32_t> modules;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        if (registry_.loaded(moduleId)) {
+            modules.push_back(moduleId);
+        }
+    }
+    std::sort(modules.begin(), modules.end(), [this](uint32_t left, uint32_t right) {
+        return exclusive_[left] > exclusive_[right];
+    });
+    out << std::endl << "modules by exclusive cost (inclusive / exclusive):" << std::endl;
+    for (size_t index = 0; index < modules.size() && index < limit; ++index) {
+        writeMilliseconds(out, graph_.loadTime(modules[index]));
+        writeMilliseconds(out, exclusive_[modules[index]]);
+        out << "  " << path(modules[index]) << std::endl;
+    }
+
+    std::vector<uint32_t> candidates;
+    for (uint32_t moduleId = 0; moduleId < registry_.size(); ++moduleId) {
+        if (moduleId != entryModuleId && reachable_[moduleId] && savings_[moduleId] > 0) {
+            candidates.push_back(moduleId);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t left, uint32_t right) {
+        return savings_[left] > savings_[right];
+    });
+    out << std::endl << "deferral candidates (saving if loaded with require.async):" << std::endl;
+    for (size_t index = 0; index < candidates.size() && index < limit; ++index) {
+        uint32_t moduleId = candidates[index];
+        writeMilliseconds(out, savings_[moduleId]);
+        out << "  " << path(moduleId) << std::endl;
+        // 需要改成 require.async 的边
+        for (uint32_t dependent : graph_.dependents(moduleId)) {
+            if (registry_.loaded(dependent)) {
+                out << "              required by " << path(dependent) << std::endl;
+            }
+        }
+    }
+    out.flags(flags);
+}
@@ -0,0 +1,57 @@
+#ifndef COMMONJS_SERVER_STARTUP_ANALYZER_H
+#define COMMONJS_SERVER_STARTUP_ANALYZER_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "dependency_graph.h"
+#include "module_registry.h"
+
+/**
+ * 启动关键路径分析。主模块同步执行完之后，根据依赖图中记录的加载区间还原加载树
+ * (每个模块挂在第一次加载它的模块下面)：
+ *  - 包含耗时: 模块的加载区间长度，包含它第一次加载的依赖
+ *  - 独占耗时: 包含耗时减去加载树中直接子模块的包含耗时
+ *  - 关键路径: 从主模块开始每一层选择包含耗时最大的子模块
+ *  - 延迟收益: 在依赖图上计算支配树，模块支配的所有模块(只能经由它加载到的模块)的独占耗时之和，
+ *    即把所有指向它的 require 改成 require.async 之后启动阶段可以省下的时间
+ * 被驱逐、还没有重新加载的模块不参与分析
+ */
+class StartupAnalyzer {
+public:
+    StartupAnalyzer(const DependencyGraph& graph, const ModuleRegistry& registry) : graph_(graph), registry_(registry) {}
+
+    /**
+     * 分析并输出报告
+     * @param out
+     * @param entryModuleId 主模块 id
+     * @param limit 耗时和延迟收益排行输出的模块数量
+     */
+    void report(std::ostream& out, uint32_t entryModuleId, size_t limit);
+
+private:
+    /**
+     * 按加载区间的嵌套关系还原加载树，计算独占耗时
+     */
+    void buildLoadTree();
+
+    /**
+     * 在依赖图上计算从主模块出发的支配树，累加每个模块支配的独占耗时
+     * @param entryModuleId
+     */
+    void computeSavings(uint32_t entryModuleId);
+
+    const std::string& path(uint32_t moduleId) const;
+
+    const DependencyGraph& graph_;
+    const ModuleRegistry& registry_;
+    // 以下都以模块 id 为下标
+    std::vector<uint32_t> loadParent_;
+    std::vector<std::vector<uint32_t>> loadChildren_;
+    std::vector<int64_t> exclusive_;
+    std::vector<int64_t> savings_;
+    // 从主模块不可达的模块为 false
+    std::vector<bool> reachable_;
+};
+
+#endif //COMMONJS_SERVER_STARTUP_ANALYZER_H
@@ -0,0 +1,41 @@
+#ifndef COMMONJS_SERVER_THREAD_POOL_H
+#define COMMONJS_SERVER_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 固定大小的后台线程池，用于模块文件的读取和后台编译
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads 线程数，为 0 时使用 CPU 核数减一(至少一个)
+     */
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * 提交任务，任务在任意一个后台线程执行
+     * @param task
+     */
+    void post(std::function<void()> task);
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+};
+
+#endif //COMMONJS_SERVER_THREAD_POOL_H
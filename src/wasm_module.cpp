@@ -0,0 +1,217 @@
+#include "wasm_module.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+void throwError(v8::Isolate* isolate, const std::string& message) {
+    isolate->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8(isolate, message.data(), v8::NewStringType::kNormal,
+                                                                         static_cast<int>(message.size())).ToLocalChecked()));
+}
+
+/**
+ * 用 new WebAssembly.Module(bytes) 同步编译
+ * @param isolate
+ * @param context
+ * @param webAssembly 全局的 WebAssembly 对象
+ * @param bytes
+ * @param length
+ * @return
+ */
+v8::MaybeLocal<v8::WasmModuleObject> compileSync(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Object> webAssembly,
+                                                 const uint8_t* bytes, size_t length) {
+    v8::Local<v8::Value> constructor;
+    if (!webAssembly->Get(context, v8::String::NewFromUtf8Literal(isolate, "Module")).ToLocal(&constructor) || !constructor->IsFunction()) {
+        return v8::MaybeLocal<v8::WasmModuleObject>();
+    }
+    // 映射的内存是只读的，不能直接作为 ArrayBuffer 交给 JS，拷贝一次
+    v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, length);
+    if (length > 0) {
+        memcpy(buffer->GetBackingStore()->Data(), bytes, length);
+    }
+    v8::Local<v8::Value> argv[] = { buffer };
+    v8::Local<v8::Object> module;
+    if (!constructor.As<v8::Function>()->NewInstance(context, 1, argv).ToLocal(&module)) {
+        return v8::MaybeLocal<v8::WasmModuleObject>();
+    }
+    return module.As<v8::WasmModuleObject>();
+}
+
+/**
+ * 取出上下文中的 WebAssembly 对象
+ * @param isolate
+ * @param context
+ * @param webAssembly
+ * @return 上下文不支持 WebAssembly 时返回 false
+ */
+bool getWebAssembly(v8::Isolate* isolate, v8::Local<v8::Context> context, v8::Local<v8::Object>& webAssembly) {
+    v8::Local<v8::Value> value;
+    if (!context->Global()->Get(context, v8::String::NewFromUtf8Literal(isolate, "WebAssembly")).ToLocal(&value) || !value->IsObject()) {
+        return false;
+    }
+    webAssembly = value.As<v8::Object>();
+    return true;
+}
+
+}
+
+void WasmModules::attach(v8::Isolate* isolate) {
+    isolate->SetData(kWasmModulesSlot, this);
+    isolate->SetWasmStreamingCallback(streamingCallback);
+}
+
+WasmModules* WasmModules::from(v8::Isolate* isolate) {
+    return static_cast<WasmModules*>(isolate->GetData(kWasmModulesSlot));
+}
+
+void WasmModules::streamingCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    std::shared_ptr<v8::WasmStreaming> streaming = v8::WasmStreaming::Unpack(isolate, info.Data());
+    if (!info[0]->IsExternal()) {
+        streaming->Abort(v8::Exception::TypeError(v8::String::NewFromUtf8Literal(isolate, "不支持的 wasm 来源")));
+        return;
+    }
+    Compilation* compilation = static_cast<Compilation*>(info[0].As<v8::External>()->Value());
+    streaming->SetUrl(compilation->path.data(), compilation->path.size());
+    if (compilation->cachedData) {
+        // 缓存头部与 wire bytes 不匹配时 v8 直接拒绝，之后按正常流程编译
+        compilation->cachedData->rejected = !streaming->SetCompiledModuleBytes(compilation->cachedData->data,
+                                                                              static_cast<size_t>(compilation->cachedData->length));
+    }
+    // 字节已经全部映射在内存里，一次交给 v8
+    streaming->OnBytesReceived(reinterpret_cast<const uint8_t*>(compilation->file->data()), compilation->file->size());
+    streaming->Finish();
+}
+
+v8::MaybeLocal<v8::WasmModuleObject> WasmModules::compile(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path,
+                                                          const uint8_t* bytes, size_t length, const SourceStamp& stamp) {
+    if (!enabled_) {
+        throwError(isolate, "构建快照时不能加载 wasm 模块: " + path);
+        return v8::MaybeLocal<v8::WasmModuleObject>();
+    }
+    v8::EscapableHandleScope handleScope(isolate);
+    // require.async 流式编译的结果，或者之前(其他上下文、热重载之前)编译过的同一份字节
+    auto found = compiled_.find(path);
+    if (found != compiled_.end() && found->second.stamp.hash == stamp.hash) {
+        return handleScope.EscapeMaybe(v8::WasmModuleObject::FromCompiledModule(isolate, *found->second.module));
+    }
+    v8::Local<v8::Object> webAssembly;
+    if (!getWebAssembly(isolate, context, webAssembly)) {
+        throwError(isolate, "当前上下文不支持 WebAssembly");
+        return v8::MaybeLocal<v8::WasmModuleObject>();
+    }
+    v8::Local<v8::WasmModuleObject> module;
+    if (!compileSync(isolate, context, webAssembly, bytes, length).ToLocal(&module)) {
+        return v8::MaybeLocal<v8::WasmModuleObject>();
+    }
+    // 同步 require 无法使用序列化的编译结果，写入缓存也没有意义，只留在进程内
+    keep(path, stamp, module, false);
+    return handleScope.Escape(module);
+}
+
+bool WasmModules::compileAsync(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path,
+                               std::unique_ptr<MappedFile> file, const SourceStamp& stamp, CompletionQueue::Callback done, void* data) {
+    auto found = compiled_.find(path);
+    if (!enabled_ || !file || (found != compiled_.end() && found->second.stamp.hash == stamp.hash)) {
+        return false;
+    }
+    v8::HandleScope handleScope(isolate);
+    // 准备失败时留给同步编译处理，这里的异常不向外抛出
+    v8::TryCatch tryCatch(isolate);
+    v8::Local<v8::Object> webAssembly;
+    v8::Local<v8::Value> compileStreaming;
+    if (!getWebAssembly(isolate, context, webAssembly) ||
+        !webAssembly->Get(context, v8::String::NewFromUtf8Literal(isolate, "compileStreaming")).ToLocal(&compileStreaming) ||
+        !compileStreaming->IsFunction()) {
+        return false;
+    }
+    std::unique_ptr<Compilation> compilation(new Compilation());
+    compilation->owner = this;
+    compilation->path = path;
+    compilation->stamp = stamp;
+    compilation->file = std::move(file);
+    compilation->cachedData.reset(codeCache_.load(path, stamp));
+    compilation->done = done;
+    compilation->data = data;
+    v8::Local<v8::External> external = v8::External::New(isolate, compilation.get());
+    v8::Local<v8::Function> onCompiled;
+    v8::Local<v8::Function> onFailed;
+    if (!v8::Function::New(context, compiled, external).ToLocal(&onCompiled) ||
+        !v8::Function::New(context, failed, external).ToLocal(&onFailed)) {
+        return false;
+    }
+    v8::Local<v8::Value> argv[] = { external };
+    v8::Local<v8::Value> result;
+    if (!compileStreaming.As<v8::Function>()->Call(context, webAssembly, 1, argv).ToLocal(&result) || !result->IsPromise()) {
+        return false;
+    }
+    // 流式回调在微任务中执行，编译结果通过平台的前台任务交回，投递任务时唤醒事件循环
+    result.As<v8::Promise>()->Then(context, onCompiled, onFailed).ToLocalChecked();
+    compilation.release();
+    return true;
+}
+
+void WasmModules::compiled(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    Compilation* compilation = static_cast<Compilation*>(info.Data().As<v8::External>()->Value());
+    WasmModules* self = compilation->owner;
+    if (info[0]->IsWasmModuleObject()) {
+        bool cacheAccepted = self->codeCache_.report(compilation->cachedData.get());
+        self->keep(compilation->path, compilation->stamp, info[0].As<v8::WasmModuleObject>(), !cacheAccepted && self->codeCache_.enabled());
+    }
+    self->finish(compilation);
+}
+
+void WasmModules::failed(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    Compilation* compilation = static_cast<Compilation*>(info.Data().As<v8::External>()->Value());
+    compilation->owner->finish(compilation);
+}
+
+void WasmModules::finish(Compilation* compilation) {
+    CompletionQueue::Callback done = compilation->done;
+    void* data = compilation->data;
+    delete compilation;
+    done(data);
+}
+
+void WasmModules::keep(const std::string& path, const SourceStamp& stamp, v8::Local<v8::WasmModuleObject> module, bool record) {
+    std::shared_ptr<v8::CompiledWasmModule> compiledModule = std::make_shared<v8::CompiledWasmModule>(module->GetCompiledModule());
+    compiled_[path] = Compiled{ stamp, compiledModule };
+    // 热重载之前的版本不再需要写入
+    recorded_.erase(std::remove_if(recorded_.begin(), recorded_.end(), [&path](const Recorded& recorded) {
+        return recorded.path == path;
+    }), recorded_.end());
+    if (!record) {
+        return;
+    }
+    // 流式编译完成之后立即写入，分层编译还没有完成时留到之后再写
+    Recorded recorded{ path, stamp, compiledModule };
+    if (!save(recorded)) {
+        recorded_.push_back(std::move(recorded));
+    }
+}
+
+bool WasmModules::save(const Recorded& recorded) {
+    // 序列化结果不包含 wire bytes，加载时仍然需要原始的 wasm 文件
+    v8::OwnedBuffer buffer = recorded.module->Serialize();
+    if (buffer.size == 0) {
+        return false;
+    }
+    v8::ScriptCompiler::CachedData data(buffer.buffer.get(), static_cast<int>(buffer.size));
+    codeCache_.save(recorded.path, recorded.stamp, &data);
+    return true;
+}
+
+void WasmModules::saveCaches() {
+    std::vector<Recorded> unsaved;
+    for (Recorded& recorded : recorded_) {
+        if (!save(recorded)) {
+            unsaved.push_back(std::move(recorded));
+        }
+    }
+    recorded_.swap(unsaved);
+}
+
+void WasmModules::clear() {
+    compiled_.clear();
+    recorded_.clear();
+}
@@ -0,0 +1,160 @@
+#ifndef COMMONJS_SERVER_WASM_MODULE_H
+#define COMMONJS_SERVER_WASM_MODULE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "v8.h"
+#include "code_cache.h"
+#include "completion_queue.h"
+#include "mapped_file.h"
+
+// isolate 数据槽中保存 WebAssembly 模块编译器的位置
+const uint32_t kWasmModulesSlot = 3;
+
+/**
+ * WebAssembly 模块编译器。
+ * require('x.wasm') 是同步的，不能在编译期间执行微任务或者其他任务，所以同步编译：
+ * 进程内已经有同一版本的编译结果时用 WasmModuleObject::FromCompiledModule 直接创建，否则 new WebAssembly.Module。
+ * v8 9.1 只能在流式编译(WasmStreaming)中使用序列化的编译结果，没有同步反序列化的接口，
+ * 所以磁盘上的编译缓存只在 require.async 中读写，同步 require 既不读也不写：
+ * 模块读取完成之后在事件循环中调用 WebAssembly.compileStreaming，有缓存时先用 SetCompiledModuleBytes 提供，
+ * 反序列化成功就跳过 Liftoff / TurboFan 编译；编译结果留在进程内，之后执行模块时的同步 require 直接取用。
+ * 没有可用缓存的模块在流式编译之后写入缓存；后台的 TurboFan 分层编译还没有完成、无法序列化时，
+ * 留到主模块执行完成之后和退出前再写。
+ */
+class WasmModules {
+public:
+    explicit WasmModules(CodeCache& codeCache) : codeCache_(codeCache) {}
+
+    /**
+     * 构建快照时 wasm 模块无法序列化，必须禁止加载
+     * @param enabled
+     */
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+
+    /**
+     * 把编译器挂到 isolate 上并设置流式编译回调。必须在创建上下文之前调用，
+     * WebAssembly.compileStreaming 只会安装到设置了回调的 isolate 创建的上下文中
+     * @param isolate
+     */
+    void attach(v8::Isolate* isolate);
+
+    static WasmModules* from(v8::Isolate* isolate);
+
+    /**
+     * 同步编译 wasm 模块，不执行微任务和平台任务
+     * @param isolate
+     * @param context
+     * @param path 模块绝对路径
+     * @param bytes wasm 字节，只在调用期间使用
+     * @param length
+     * @param stamp 模块源码版本戳，用于匹配进程内的编译结果
+     * @return 失败时抛出异常并返回空
+     */
+    v8::MaybeLocal<v8::WasmModuleObject> compile(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path,
+                                                 const uint8_t* bytes, size_t length, const SourceStamp& stamp);
+
+    /**
+     * 在事件循环中流式编译 wasm 模块，使用磁盘上的编译缓存。编译结果留在进程内供之后的 compile 使用，
+     * 编译失败时什么也不留，由之后的 compile 重新编译并抛出异常
+     * @param isolate
+     * @param context
+     * @param path 模块绝对路径
+     * @param file 映射的 wasm 文件，编译结束之前由编译器持有
+     * @param stamp 模块源码版本戳
+     * @param done 编译结束(无论成败)时在 isolate 线程上调用 done(data)。编译由平台的前台任务推进，调用者需要保持事件循环运行
+     * @param data
+     * @return 是否开始了编译，返回 false 时不会调用 done
+     */
+    bool compileAsync(v8::Isolate* isolate, v8::Local<v8::Context> context, const std::string& path,
+                      std::unique_ptr<MappedFile> file, const SourceStamp& stamp, CompletionQueue::Callback done, void* data);
+
+    /**
+     * 序列化还没有写入缓存的模块并写入缓存文件。主模块执行完成之后和退出前调用
+     */
+    void saveCaches();
+
+    /**
+     * 释放所有编译结果。构建快照之前和 isolate 销毁之前必须调用
+     */
+    void clear();
+
+    // 流式编译回调，需要登记到快照的 external references 中
+    static void streamingCallback(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+private:
+    /**
+     * 一次流式编译，以 External 的形式传给 compileStreaming 和 Promise 的回调，编译结束时释放
+     */
+    struct Compilation {
+        WasmModules* owner;
+        std::string path;
+        SourceStamp stamp;
+        std::unique_ptr<MappedFile> file;
+        std::unique_ptr<v8::ScriptCompiler::CachedData> cachedData;
+        CompletionQueue::Callback done;
+        void* data;
+    };
+
+    /**
+     * 进程内的编译结果，版本戳一致时可以在任意上下文中重新创建模块对象
+     */
+    struct Compiled {
+        SourceStamp stamp;
+        std::shared_ptr<v8::CompiledWasmModule> module;
+    };
+
+    /**
+     * 等待写入缓存的模块
+     */
+    struct Recorded {
+        std::string path;
+        SourceStamp stamp;
+        std::shared_ptr<v8::CompiledWasmModule> module;
+    };
+
+    /**
+     * 保存编译结果，需要时写入缓存
+     * @param path
+     * @param stamp
+     * @param module
+     * @param record 是否需要写入缓存文件
+     */
+    void keep(const std::string& path, const SourceStamp& stamp, v8::Local<v8::WasmModuleObject> module, bool record);
+
+    /**
+     * 序列化模块并写入缓存文件
+     * @param recorded
+     * @return 分层编译还没有完成、暂时无法序列化时返回 false
+     */
+    bool save(const Recorded& recorded);
+
+    /**
+     * 流式编译完成
+     * @param info
+     */
+    static void compiled(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    /**
+     * 流式编译失败
+     * @param info
+     */
+    static void failed(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    /**
+     * 结束一次流式编译
+     * @param compilation
+     */
+    void finish(Compilation* compilation);
+
+    CodeCache& codeCache_;
+    bool enabled_ = true;
+    // 绝对路径 -> 编译结果
+    std::unordered_map<std::string, Compiled> compiled_;
+    std::vector<Recorded> recorded_;
+};
+
+#endif //COMMONJS_SERVER_WASM_MODULE_H
@@ -0,0 +1,130 @@
+#include <poll.h>
+#include <thread>
+#include <vector>
+#include "completion_queue.h"
+#include "test.h"
+
+namespace {
+
+// 每个生产者放入的任务数
+const int kTasksPerProducer = 20000;
+const int kProducers = 4;
+
+struct Task {
+    int producer;
+    int sequence;
+};
+
+int executed = 0;
+
+void execute(void* data) {
+    (void) data;
+    executed++;
+}
+
+/**
+ * eventfd 是否可读
+ * @param queue
+ * @param timeoutMillis
+ * @return
+ */
+bool readable(const CompletionQueue& queue, int timeoutMillis) {
+    struct pollfd pollFd = { queue.fd(), POLLIN, 0 };
+    return poll(&pollFd, 1, timeoutMillis) == 1 && (pollFd.revents & POLLIN) != 0;
+}
+
+void testSingleThread() {
+    CompletionQueue queue;
+    EXPECT_TRUE(queue.open());
+    std::vector<CompletionQueue::Completion> completions;
+    queue.take(completions);
+    EXPECT_EQ(completions.size(), 0u);
+    EXPECT_TRUE(!readable(queue, 0));
+
+    Task tasks[3] = { { 0, 0 }, { 0, 1 }, { 0, 2 } };
+    for (Task& task : tasks) {
+        queue.push(execute, &task);
+    }
+    // 由空变为非空时唤醒一次，取走之后不再可读
+    EXPECT_TRUE(readable(queue, 0));
+    queue.take(completions);
+    EXPECT_TRUE(!readable(queue, 0));
+    EXPECT_EQ(completions.size(), 3u);
+    for (size_t index = 0; index < completions.size(); ++index) {
+        EXPECT_TRUE(completions[index].data == &tasks[index]);
+        completions[index].callback(completions[index].data);
+    }
+    EXPECT_EQ(executed, 3);
+
+    // 取走之后放入的任务重新唤醒
+    queue.push(execute, &tasks[0]);
+    EXPECT_TRUE(readable(queue, 0));
+    completions.clear();
+    queue.take(completions);
+    EXPECT_EQ(completions.size(), 1u);
+
+    // 只唤醒不放入任务
+    queue.signal();
+    EXPECT_TRUE(readable(queue, 0));
+    completions.clear();
+    queue.take(completions);
+    EXPECT_EQ(completions.size(), 0u);
+    EXPECT_TRUE(!readable(queue, 0));
+}
+
+void testProducers() {
+    CompletionQueue queue;
+    EXPECT_TRUE(queue.open());
+    std::vector<std::vector<Task>> tasks(kProducers, std::vector<Task>(kTasksPerProducer));
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < kProducers; ++producer) {
+        producers.emplace_back([&queue, &tasks, producer]() {
+            for (int sequence = 0; sequence < kTasksPerProducer; ++sequence) {
+                Task& task = tasks[producer][sequence];
+                task.producer = producer;
+                task.sequence = sequence;
+                queue.push(execute, &task);
+            }
+        });
+    }
+
+    // 只在 eventfd 可读时取，检查每个任务恰好取出一次，同一个生产者的任务保持放入顺序
+    std::vector<int> next(kProducers, 0);
+    std::vector<CompletionQueue::Completion> completions;
+    size_t total = 0;
+    bool ordered = true;
+    while (total < static_cast<size_t>(kProducers * kTasksPerProducer)) {
+        if (!readable(queue, 5000)) {
+            break;
+        }
+        completions.clear();
+        queue.take(completions);
+        for (const CompletionQueue::Completion& completion : completions) {
+            Task* task = static_cast<Task*>(completion.data);
+            if (task->sequence != next[task->producer]) {
+                ordered = false;
+            }
+            next[task->producer] = task->sequence + 1;
+        }
+        total += completions.size();
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    EXPECT_EQ(total, static_cast<size_t>(kProducers * kTasksPerProducer));
+    EXPECT_TRUE(ordered);
+    for (int producer = 0; producer < kProducers; ++producer) {
+        EXPECT_EQ(next[producer], kTasksPerProducer);
+    }
+    completions.clear();
+    queue.take(completions);
+    EXPECT_EQ(completions.size(), 0u);
+}
+
+}
+
+int main() {
+    testSingleThread();
+    testProducers();
+    return test::finish("completion_queue_test");
+}
@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "dependency_graph.h"
+#include "module_registry.h"
+#include "path_resolver.h"
+#include "startup_analyzer.h"
+#include "test.h"
+
+namespace {
+
+const int64_t kMillisecond = 1000000;
+
+/**
+ * 按报告的格式输出一行耗时
+ * @param milliseconds
+ * @return
+ */
+std::string column(int64_t milliseconds) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%10.2fms", static_cast<double>(milliseconds));
+    return buffer;
+}
+
+/**
+ * 注册一组模块，模块 id 与下标一致
+ * @param isolate
+ * @param context
+ * @param paths
+ * @param registry
+ * @param names
+ */
+void createModules(v8::Isolate* isolate, v8::Local<v8::Context> context, PathTable& paths, ModuleRegistry& registry,
+                   const std::vector<std::string>& names) {
+    for (const std::string& name : names) {
+        uint32_t moduleId;
+        registry.create(isolate, context, paths.intern("/t/" + name + ".js"), v8::Object::New(isolate), moduleId);
+    }
+}
+
+void testEdges(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    PathTable paths;
+    ModuleRegistry registry(paths);
+    registry.attach(isolate);
+    DependencyGraph graph(registry);
+    createModules(isolate, context, paths, registry, { "main", "a", "b", "c" });
+    EXPECT_TRUE(graph.addEdge(0, 1));
+    EXPECT_TRUE(graph.addEdge(0, 2));
+    EXPECT_TRUE(graph.addEdge(1, 3));
+    EXPECT_TRUE(graph.addEdge(2, 3));
+    // 重复的边去重
+    EXPECT_TRUE(!graph.addEdge(1, 3));
+    EXPECT_EQ(graph.edgeCount(), 4u);
+    EXPECT_EQ(graph.dependencies(0).size(), 2u);
+    EXPECT_EQ(graph.dependents(3).size(), 2u);
+    EXPECT_EQ(graph.dependencies(3).size(), 0u);
+    // 越界的模块没有边
+    EXPECT_EQ(graph.dependents(100).size(), 0u);
+
+    // 沿反向边收集所有直接或间接依赖的模块，结果升序
+    std::vector<uint32_t> dependents = graph.transitiveDependents({ 3 });
+    EXPECT_EQ(dependents.size(), 4u);
+    for (uint32_t index = 0; index < dependents.size(); ++index) {
+        EXPECT_EQ(dependents[index], index);
+    }
+    EXPECT_EQ(graph.transitiveDependents({ 1 }).size(), 2u);
+
+    // 模块重新执行之前删掉它的出边，反向边同时删除
+    graph.removeDependencies(1);
+    EXPECT_EQ(graph.dependencies(1).size(), 0u);
+    EXPECT_EQ(graph.dependents(3).size(), 1u);
+    EXPECT_EQ(graph.dependents(3)[0], 2u);
+    EXPECT_TRUE(graph.addEdge(1, 3));
+    registry.clear();
+}
+
+/**
+ * main -> a -> shared
+ *           -> onlyA -> leaf
+ *      -> b -> shared
+ * shared 第一次由 a 加载。b 不支配 shared，a 支配 onlyA 和 leaf
+ */
+void testAnalyzer(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    PathTable paths;
+    ModuleRegistry registry(paths);
+    registry.attach(isolate);
+    DependencyGraph graph(registry);
+    createModules(isolate, context, paths, registry, { "main", "a", "b", "shared", "onlyA", "leaf" });
+    const uint32_t entry = 0, a = 1, b = 2, shared = 3, onlyA = 4, leaf = 5;
+    graph.addEdge(entry, a);
+    graph.addEdge(entry, b);
+    graph.addEdge(a, shared);
+    graph.addEdge(a, onlyA);
+    graph.addEdge(onlyA, leaf);
+    graph.addEdge(b, shared);
+    // 加载区间(毫秒)，嵌套关系即加载树
+    graph.setLoadSpan(entry, 1 * kMillisecond, 11 * kMillisecond);
+    graph.setLoadSpan(a, 2 * kMillisecond, 8 * kMillisecond);
+    graph.setLoadSpan(shared, 3 * kMillisecond, 4 * kMillisecond);
+    graph.setLoadSpan(onlyA, 4 * kMillisecond, 7 * kMillisecond);
+    graph.setLoadSpan(leaf, 5 * kMillisecond, 6 * kMillisecond);
+    graph.setLoadSpan(b, 8 * kMillisecond, 10 * kMillisecond);
+
+    std::ostringstream out;
+    StartupAnalyzer analyzer(graph, registry);
+    analyzer.report(out, entry, 20);
+    std::string report = out.str();
+
+    EXPECT_TRUE(report.find("startup:" + column(10) + "  modules: 6  edges: 6\n") != std::string::npos);
+    // 独占耗时: main 10-6-2, a 6-1-3, onlyA 3-1；关键路径每层选包含耗时最大的子模块
+    std::string criticalPath = "critical path (inclusive / exclusive):\n" +
+            column(10) + column(2) + "  /t/main.js\n" +
+            column(6) + column(2) + "  /t/a.js\n" +
+            column(3) + column(2) + "  /t/onlyA.js\n" +
+            column(1) + column(1) + "  /t/leaf.js\n\n";
+    EXPECT_TRUE(report.find(criticalPath) != std::string::npos);
+    // 延迟收益是支配的独占耗时之和: a = 2 + onlyA 2 + leaf 1，shared 同时被 b 依赖，不计入 a
+    size_t candidates = report.find("deferral candidates");
+    EXPECT_TRUE(candidates != std::string::npos);
+    std::string deferral = candidates == std::string::npos ? std::string() : report.substr(candidates);
+    EXPECT_TRUE(deferral.find(column(5) + "  /t/a.js\n              required by /t/main.js\n" +
+                              column(3) + "  /t/onlyA.js\n              required by /t/a.js\n" +
+                              column(2) + "  /t/b.js\n              required by /t/main.js\n") != std::string::npos);
+    EXPECT_TRUE(deferral.find(column(1) + "  /t/shared.js\n              required by /t/a.js\n              required by /t/b.js\n") !=
+                std::string::npos);
+    EXPECT_TRUE(deferral.find(column(1) + "  /t/leaf.js\n              required by /t/onlyA.js\n") != std::string::npos);
+    // 主模块不是候选
+    EXPECT_TRUE(deferral.find("  /t/main.js\n") == std::string::npos);
+
+    std::ostringstream missing;
+    analyzer.report(missing, kInvalidModuleId, 20);
+    EXPECT_EQ(missing.str(), std::string("entry module was not loaded\n"));
+    registry.clear();
+}
+
+/**
+ * 热重载驱逐之后没有重新加载的模块不出现在输出中，也不计入分析
+ */
+void testEvicted(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    PathTable paths;
+    ModuleRegistry registry(paths);
+    registry.attach(isolate);
+    DependencyGraph graph(registry);
+    createModules(isolate, context, paths, registry, { "main", "a", "stale" });
+    const uint32_t entry = 0, a = 1, stale = 2;
+    graph.addEdge(entry, a);
+    graph.addEdge(entry, stale);
+    graph.setLoadSpan(entry, 1 * kMillisecond, 10 * kMillisecond);
+    graph.setLoadSpan(a, 2 * kMillisecond, 4 * kMillisecond);
+    graph.setLoadSpan(stale, 4 * kMillisecond, 9 * kMillisecond);
+    registry.evict(stale);
+    EXPECT_TRUE(!registry.loaded(stale));
+    EXPECT_TRUE(registry.loaded(a));
+
+    std::ostringstream json;
+    graph.writeJson(json);
+    EXPECT_EQ(json.str(), std::string("{\"modules\":[{\"id\":0,\"uri\":\"/t/main.js\",\"loadTime\":9,\"dependencies\":[1]},"
+                                      "{\"id\":1,\"uri\":\"/t/a.js\",\"loadTime\":2,\"dependencies\":[]}]}\n"));
+    std::ostringstream dot;
+    graph.writeDot(dot);
+    EXPECT_TRUE(dot.str().find("stale") == std::string::npos);
+    EXPECT_TRUE(dot.str().find("m0 -> m2") == std::string::npos);
+
+    std::ostringstream out;
+    StartupAnalyzer analyzer(graph, registry);
+    analyzer.report(out, entry, 20);
+    std::string report = out.str();
+    EXPECT_TRUE(report.find("  modules: 2  edges: 1\n") != std::string::npos);
+    EXPECT_TRUE(report.find("/t/stale.js") == std::string::npos);
+    registry.clear();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    (void) argc;
+    v8::V8::InitializeICUDefaultLocation(argv[0]);
+    v8::V8::InitializeExternalStartupData(argv[0]);
+    std::unique_ptr<v8::Platform> platform = v8::platform::NewDefaultPlatform();
+    v8::V8::InitializePlatform(platform.get());
+    v8::V8::Initialize();
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    {
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> context = v8::Context::New(isolate);
+        v8::Context::Scope contextScope(context);
+        testEdges(isolate, context);
+        testAnalyzer(isolate, context);
+        testEvicted(isolate, context);
+    }
+    isolate->Dispose();
+    v8::V8::Dispose();
+    v8::V8::ShutdownPlatform();
+    delete create_params.array_buffer_allocator;
+    return test::finish("dependency_graph_test");
+}
@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include "path_resolver.h"
+#include "test.h"
+
+namespace {
+
+/**
+ * 在临时目录下创建文件，中间目录按需创建
+ * @param root
+ * @param path 相对 root 的路径
+ * @param content
+ */
+void writeFile(const std::string& root, const std::string& path, const std::string& content) {
+    for (size_t index = path.find('/'); index != std::string::npos; index = path.find('/', index + 1)) {
+        mkdir((root + "/" + path.substr(0, index)).c_str(), 0755);
+    }
+    std::ofstream(root + "/" + path) << content;
+}
+
+void testAbsolutePath() {
+    EXPECT_EQ(getAbsolutePath("b.js", "/a"), "/a/b.js");
+    EXPECT_EQ(getAbsolutePath("./c/../d.js", "/a/b"), "/a/b/d.js");
+    EXPECT_EQ(getAbsolutePath("../x.js", "/a/b"), "/a/x.js");
+    EXPECT_EQ(getAbsolutePath("/x/./y.js", "/a"), "/x/y.js");
+    EXPECT_EQ(getAbsolutePath("x.js", "/"), "/x.js");
+    EXPECT_EQ(getAbsolutePath("a\\b.js", "/"), "/a/b.js");
+    // 越过根目录的 .. 停在根目录
+    EXPECT_EQ(getAbsolutePath("../../../../x", "/"), "/x");
+    EXPECT_EQ(getAbsolutePath("../../../../x", "/a/b"), "/x");
+    EXPECT_EQ(getAbsolutePath("..", "/"), "/");
+    EXPECT_EQ(getAbsolutePath("/..", "/a"), "/");
+    EXPECT_EQ(getAbsolutePath("../..", "a"), ".");
+}
+
+void testResolve(const std::string& root) {
+    writeFile(root, "a.js", "");
+    writeFile(root, "data.json", "{}");
+    writeFile(root, "lib/index.js", "");
+    writeFile(root, "src/app.js", "");
+    writeFile(root, "node_modules/pkg/package.json", "{\"name\": \"pkg\", \"main\": \"./dist/main\"}");
+    writeFile(root, "node_modules/pkg/dist/main.js", "");
+    writeFile(root, "node_modules/plain/index.js", "");
+
+    PathTable paths;
+    PathResolver resolver(paths);
+    uint32_t rootId = paths.intern(root);
+    uint32_t srcId = paths.intern(root + "/src");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./a")), root + "/a.js");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./data")), root + "/data.json");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./lib")), root + "/lib/index.js");
+    EXPECT_EQ(paths.path(resolver.resolve(srcId, "../a.js")), root + "/a.js");
+    // node_modules 从父模块目录开始逐级向上查找
+    EXPECT_EQ(paths.path(resolver.resolve(srcId, "pkg")), root + "/node_modules/pkg/dist/main.js");
+    EXPECT_EQ(paths.path(resolver.resolve(srcId, "plain")), root + "/node_modules/plain/index.js");
+    // 找不到时补上 .js 后缀，由加载时报告文件不存在
+    EXPECT_EQ(paths.path(resolver.resolve(srcId, "./missing")), root + "/src/missing.js");
+    uint32_t rootDirId = paths.intern("/");
+    EXPECT_EQ(paths.path(resolver.resolve(rootDirId, "../../../../x")), "/x.js");
+    // 重复的解析命中缓存，得到同一个 id
+    EXPECT_EQ(resolver.resolve(srcId, "pkg"), resolver.resolve(srcId, "pkg"));
+}
+
+void testInvalidate(const std::string& root) {
+    PathTable paths;
+    PathResolver resolver(paths);
+    uint32_t rootId = paths.intern(root);
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./later")), root + "/later.js");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "fresh")), root + "/fresh.js");
+    // 之后创建的目录和 node_modules 包，在通知变化之前仍然命中旧的结果
+    writeFile(root, "later/index.js", "");
+    writeFile(root, "node_modules/fresh/index.js", "");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./later")), root + "/later.js");
+    resolver.invalidate(root, "later");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "./later")), root + "/later/index.js");
+    resolver.invalidate(root + "/node_modules", "fresh");
+    EXPECT_EQ(paths.path(resolver.resolve(rootId, "fresh")), root + "/node_modules/fresh/index.js");
+}
+
+}
+
+int main() {
+    char buffer[] = "/tmp/path_resolver_test.XXXXXX";
+    if (mkdtemp(buffer) == nullptr) {
+        return 1;
+    }
+    std::string root(buffer);
+    testAbsolutePath();
+    testResolve(root);
+    testInvalidate(root);
+    std::string command = "rm -rf " + root;
+    if (system(command.c_str()) != 0) {
+        return 1;
+    }
+    return test::finish("path_resolver_test");
+}
@@ -0,0 +1,3 @@
+define(function (require, exports, module) {
+  module.exports.value = 1;
+});
@@ -0,0 +1,3 @@
+define(function (require, exports, module) {
+  print(String(require('./main').run()));
+});
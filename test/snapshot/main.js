@@ -0,0 +1,7 @@
+define(function (require, exports, module) {
+  const a = require('./a');
+  // 闭包持有本模块的 require 对象，快照恢复之后仍然相对于本模块解析
+  module.exports.run = function () {
+    return a.value + require('./b').value;
+  };
+});
@@ -0,0 +1,15 @@
+#!/bin/sh
+# 构建包含多个模块的快照，再从快照恢复：快照中的 module 对象和 require 对象带着内部字段，
+# 恢复之后通过快照里的 require 对象加载新的模块
+# 用法: run.sh <commonjs_server> <本目录>
+set -e
+server="$1"
+cd "$2"
+blob="$(mktemp)"
+trap 'rm -f "$blob"' EXIT
+"$server" --no-code-cache --build-snapshot main.js -o "$blob"
+output="$("$server" --no-code-cache --snapshot "$blob" check.js)"
+if [ "$output" != "3" ]; then
+    echo "快照恢复之后的输出为 '$output'，期望 '3'" >&2
+    exit 1
+fi
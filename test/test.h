@@ -0,0 +1,45 @@
+#ifndef COMMONJS_SERVER_TEST_H
+#define COMMONJS_SERVER_TEST_H
+
+#include <iostream>
+
+/**
+ * 最小的测试断言。失败时输出位置和两边的值，测试程序以失败的断言数作为退出码
+ */
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+template <typename Actual, typename Expected>
+void expectEqual(const Actual& actual, const Expected& expected, const char* actualText, const char* file, int line) {
+    if (actual == expected) {
+        return;
+    }
+    failures()++;
+    std::cerr << file << ":" << line << ": " << actualText << " == " << actual << ", 期望 " << expected << std::endl;
+}
+
+inline void expectTrue(bool value, const char* text, const char* file, int line) {
+    if (value) {
+        return;
+    }
+    failures()++;
+    std::cerr << file << ":" << line << ": " << text << " 不成立" << std::endl;
+}
+
+inline int finish(const char* name) {
+    if (failures() == 0) {
+        std::cerr << name << ": ok" << std::endl;
+    }
+    return failures();
+}
+
+}
+
+#define EXPECT_EQ(actual, expected) test::expectEqual((actual), (expected), #actual, __FILE__, __LINE__)
+#define EXPECT_TRUE(value) test::expectTrue((value), #value, __FILE__, __LINE__)
+
+#endif //COMMONJS_SERVER_TEST_H
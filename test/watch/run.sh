@@ -0,0 +1,54 @@
+#!/bin/sh
+# --watch 模式下原地截断并改写已经加载的模块文件：热重载之后旧模块的函数源码仍然可以读取，
+# 进程不会因为读到截断的映射而收到 SIGBUS
+# 用法: run.sh <commonjs_server>
+set -e
+server="$1"
+dir="$(mktemp -d)"
+pid=""
+trap 'if [ -n "$pid" ]; then kill "$pid" 2>/dev/null || true; fi; rm -rf "$dir"' EXIT
+cd "$dir"
+
+# 函数放在前几页之后，截断之后它的源码整页落在文件末尾之外
+{
+    index=0
+    while [ $index -lt 200 ]; do
+        echo "// padding $index ......................................................"
+        index=$((index + 1))
+    done
+    echo "module.exports = function version() { return 'v1'; };"
+} > lib.js
+cat > main.js <<'JS'
+var version = require('./lib');
+// 重新执行时仍然持有第一次加载的函数
+if (!globalThis.first) {
+    globalThis.first = version;
+}
+print(version() + ' ' + first.toString());
+JS
+
+# 等待输出中出现指定的行，最多 5 秒
+waitFor() {
+    tries=0
+    while ! grep -qxF "$1" out; do
+        if ! kill -0 "$pid" 2>/dev/null; then
+            echo "进程已经退出，输出:" >&2
+            cat out >&2
+            exit 1
+        fi
+        tries=$((tries + 1))
+        if [ $tries -gt 50 ]; then
+            echo "没有等到 '$1'，输出:" >&2
+            cat out >&2
+            exit 1
+        fi
+        sleep 0.1
+    done
+}
+
+"$server" --no-code-cache --watch main.js > out 2>&1 &
+pid=$!
+waitFor "v1 function version() { return 'v1'; }"
+# 重定向以 O_TRUNC 打开同一个 inode 原地改写
+echo "module.exports = function version() { return 'v2'; };" > lib.js
+waitFor "v2 function version() { return 'v1'; }"